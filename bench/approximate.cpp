@@ -0,0 +1,55 @@
+#include <cstdio>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../price_ladder.h"
+#include "bench_util.h"
+
+/*
+Exact target walk against the approximate mode (bucketTicks_) on a deep synthetic book
+(40000 live orders spread over about a thousand ticks per side), for targets from a few levels to a large part of the side.
+The output, error bound included, is formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -o bench_approximate bench/approximate.cpp
+*/
+
+std::vector<FeedEvent> deepFeed()
+{
+    FeedParams params;
+    params.events = 1000000;
+    params.maxOrders = 40000;
+    params.dispersion = 200.0;
+    params.addRatio = 0.5;
+    return generateEvents(params);
+}
+
+template <class Levels>
+double replay(const std::vector<FeedEvent>& events, const int target, const Tick bucketTicks)
+{
+    double seconds = bestOf(3, [&events, target, bucketTicks]
+    {
+        NullSink sink;
+        BookAnalyzer<Levels> bookAnalyzer(RuntimeParams(target), sink.writer());
+        bookAnalyzer.bucketTicks_ = bucketTicks;
+        return timed([&] { replayEvents(bookAnalyzer, events); sink.writer().flush(); });
+    });
+    return events.size() / seconds;
+}
+
+int main()
+{
+    std::vector<FeedEvent> events = deepFeed();
+
+    std::printf("%-8s %8s %12s %12s %12s   (events/s, best of 3, %zu events)\n", "book", "target", "exact", "buckets 10", "buckets 50",
+                events.size());
+
+    for (int target : {1000, 100000, 1000000, 4000000})
+    {
+        std::printf("%-8s %8d %12.0f %12.0f %12.0f\n", "map", target, replay<MapLevels>(events, target, 0),
+                    replay<MapLevels>(events, target, 10), replay<MapLevels>(events, target, 50));
+        std::printf("%-8s %8d %12.0f %12.0f %12.0f\n", "ladder", target, replay<PriceLadder<>>(events, target, 0),
+                    replay<PriceLadder<>>(events, target, 10), replay<PriceLadder<>>(events, target, 50));
+    }
+
+    return 0;
+}
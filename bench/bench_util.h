@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include "../feed_event.h"
+#include "../output_writer.h"
+#include "../tools/synthetic_feed.h"
+
+/*
+What the benchmarks share: a sink for the engine output, the best of a few timed runs, and the replay of feed events.
+A benchmark keeps only its own setup, e.g.
+
+    double seconds = bestOf(3, [&events]
+    {
+        NullSink sink;
+        BookAnalyzer<MapLevels> bookAnalyzer(RuntimeParams(200), sink.writer());
+        return timed([&] { replayEvents(bookAnalyzer, events); sink.writer().flush(); });
+    });
+*/
+
+//stream buffer dropping whatever is written to it
+struct NullBuffer : std::streambuf
+{
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+//an OutputWriter whose lines are formatted as usual and then discarded
+class NullSink
+{
+public:
+
+    NullSink() : stream_(&buffer_), writer_(stream_)
+    {   }
+
+    OutputWriter& writer() { return writer_; }
+
+private:
+
+    NullBuffer buffer_;
+    std::ostream stream_;
+    OutputWriter writer_;
+};
+
+//seconds taken by f
+template <class F>
+double timed(F&& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+//the fastest of runs calls of run, which does its own setup and returns the seconds it timed
+template <class Run>
+double bestOf(const int runs, Run&& run)
+{
+    double best = 1e30;
+    for (int i = 0; i < runs; ++i)
+        best = std::min(best, run());
+    return best;
+}
+
+//apply the events to the book in order, as main.cpp does
+template <class Analyzer>
+void replayEvents(Analyzer& bookAnalyzer, const std::vector<FeedEvent>& events)
+{
+    for (const FeedEvent& event : events)
+        applyFeedEvent(bookAnalyzer, event);
+}
+
+//the whole synthetic feed of params
+inline std::vector<FeedEvent> generateEvents(const FeedParams& params)
+{
+    std::vector<FeedEvent> events;
+    SyntheticFeed feed(params);
+    FeedEvent event;
+    while (feed.next(event))
+        events.push_back(event);
+    return events;
+}
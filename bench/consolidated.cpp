@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../price_ladder.h"
+#include "bench_util.h"
+
+/*
+Cost of the consolidated book: V synthetic venue feeds around the same mid are merged by timestamp
+(ids qualified with the venue) and replayed into one book, with and without venue attribution.
+The output, venue split included, is formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -o bench_consolidated bench/consolidated.cpp
+*/
+
+std::vector<FeedEvent> venueFeeds(const int venues, const long eventsPerVenue)
+{
+    std::vector<FeedEvent> events;
+    for (int venue = 0; venue < venues; ++venue)
+    {
+        FeedParams params;
+        params.events = eventsPerVenue;
+        params.seed = static_cast<unsigned>(venue + 1);
+
+        SyntheticFeed feed(params);
+        FeedEvent event;
+        while (feed.next(event))
+        {
+            event.venue = venue;
+            qualifyVenueId(event);
+            events.push_back(event);
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const FeedEvent& a, const FeedEvent& b) { return a.timestamp < b.timestamp; });
+    return events;
+}
+
+template <class Levels>
+double replay(const std::vector<FeedEvent>& events, const bool consolidated)
+{
+    double seconds = bestOf(3, [&events, consolidated]
+    {
+        NullSink sink;
+        BookAnalyzer<Levels> bookAnalyzer(RuntimeParams(200), sink.writer());
+        bookAnalyzer.consolidated_ = consolidated;
+        return timed([&] { replayEvents(bookAnalyzer, events); sink.writer().flush(); });
+    });
+    return events.size() / seconds;
+}
+
+int main()
+{
+    std::printf("%-8s %7s %14s %14s   (events/s, best of 3, 2M events in total)\n", "book", "venues", "single", "consolidated");
+
+    for (int venues : {1, 2, 4, 8})
+    {
+        std::vector<FeedEvent> events = venueFeeds(venues, 2000000 / venues);
+        std::printf("%-8s %7d %14.0f %14.0f\n", "map", venues, replay<MapLevels>(events, false), replay<MapLevels>(events, true));
+        std::printf("%-8s %7d %14.0f %14.0f\n", "ladder", venues, replay<PriceLadder<>>(events, false), replay<PriceLadder<>>(events, true));
+    }
+
+    return 0;
+}
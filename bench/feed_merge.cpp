@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../feed_merge.h"
+#include "../price_ladder.h"
+#include "bench_util.h"
+
+/*
+Merge throughput as the number of feeds grows: one synthetic feed is dealt round robin into N files
+(in the temporary directory), which are then merged back by FeedMerge, alone and feeding a book.
+The output is formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -pthread -o bench_merge bench/feed_merge.cpp
+Usage: bench_merge [directory]   (default /tmp)
+*/
+
+std::vector<std::string> split(const std::vector<FeedEvent>& events, const size_t n, const std::string& directory)
+{
+    std::vector<std::string> files;
+    std::vector<std::ofstream> outs;
+    for (size_t i = 0; i < n; ++i)
+    {
+        files.push_back(directory + "/bench_merge." + std::to_string(i) + ".in");
+        outs.emplace_back(files.back());
+    }
+
+    for (size_t i = 0; i < events.size(); ++i)
+        SyntheticFeed::write(outs[i % n], events[i]);
+
+    return files;
+}
+
+//events per second, best of 3; with a book every run starts from an empty one
+double merge(const std::vector<std::string>& files, const bool book)
+{
+    long events = 0;
+    double seconds = bestOf(3, [&files, book, &events]
+    {
+        NullSink sink;
+        BookAnalyzer<PriceLadder<>> bookAnalyzer(RuntimeParams(200), sink.writer());
+        long count = 0;
+
+        return timed([&]
+        {
+            FeedMerge merge(files);
+            if (book)
+                events = merge.run([&bookAnalyzer](const FeedEvent& event) { applyFeedEvent(bookAnalyzer, event); });
+            else
+                events = merge.run([&count](const FeedEvent&) { ++count; });
+            sink.writer().flush();
+        });
+    });
+    return events / seconds;
+}
+
+int main(int argc, char** argv)
+{
+    std::string directory = argc > 1 ? argv[1] : "/tmp";
+
+    FeedParams params;
+    params.events = 2000000;
+    std::vector<FeedEvent> events = generateEvents(params);
+
+    std::printf("%6s %14s %14s   (events/s, best of 3, %zu events)\n", "feeds", "merge only", "merge + book", events.size());
+
+    for (size_t n : {1, 2, 4, 8, 16, 32})
+    {
+        std::vector<std::string> files = split(events, n, directory);
+
+        double mergeOnly = merge(files, false);
+        double withBook = merge(files, true);
+
+        std::printf("%6zu %14.0f %14.0f\n", n, mergeOnly, withBook);
+
+        for (const std::string& file : files)
+            std::remove(file.c_str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../price_ladder.h"
+#include "bench_util.h"
+
+/*
+Compares the engine with the target and tick scale known at run time (RuntimeParams)
+against the engine specialized at compile time (FixedParams), on book_analyzer.in and on a synthetic feed.
+The output is formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -o bench_fixed bench/fixed_params.cpp
+Usage: bench_fixed [file]   (default book_analyzer.in)
+*/
+
+std::vector<FeedEvent> loadFeed(const char* file)
+{
+    std::vector<FeedEvent> events;
+    std::ifstream infile(file);
+    std::string line;
+    FeedEvent event;
+    while (std::getline(infile, line) && parseFeedEvent(line, event))
+        events.push_back(event);
+    return events;
+}
+
+template <class Levels, class Params>
+double replay(const std::vector<FeedEvent>& events, const Params& params)
+{
+    double seconds = bestOf(5, [&events, &params]
+    {
+        NullSink sink;
+        BookAnalyzer<Levels, Params> bookAnalyzer(params, sink.writer());
+        return timed([&] { replayEvents(bookAnalyzer, events); sink.writer().flush(); });
+    });
+    return seconds * 1e9 / events.size();
+}
+
+template <int Target>
+void compare(const char* name, const std::vector<FeedEvent>& events)
+{
+    std::printf("%-18s %6d %10.1f %10.1f %10.1f %10.1f\n", name, Target,
+                replay<MapLevels>(events, RuntimeParams(Target)), replay<MapLevels>(events, FixedParams<Target>()),
+                replay<PriceLadder<>>(events, RuntimeParams(Target)), replay<PriceLadder<>>(events, FixedParams<Target>()));
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<FeedEvent> real = loadFeed(argc > 1 ? argv[1] : "book_analyzer.in");
+
+    FeedParams params;
+    params.events = 1000000;
+    std::vector<FeedEvent> synthetic = generateEvents(params);
+
+    std::printf("%-18s %6s %10s %10s %10s %10s   (ns/event, best of 5)\n", "feed", "target", "map rt", "map fixed", "ladder rt", "ladder fx");
+    if (!real.empty())
+    {
+        compare<200>("book_analyzer.in", real);
+        compare<10000>("book_analyzer.in", real);
+    }
+    compare<200>("synthetic", synthetic);
+    compare<1000>("synthetic", synthetic);
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../itch_decoder.h"
+#include "../price_ladder.h"
+#include "../tools/itch_writer.h"
+#include "bench_util.h"
+
+/*
+Messages per second feeding the book from an ITCH 5.0 capture held in memory (itch_decoder.h),
+against the same synthetic feed as A/R/M text parsed line by line as main.cpp does.
+The output is formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -o bench_itch bench/itch_decode.cpp
+*/
+
+template <class Levels>
+double decodeItch(const std::vector<uint8_t>& capture, long& messages)
+{
+    double seconds = bestOf(3, [&capture, &messages]
+    {
+        NullSink sink;
+        BookAnalyzer<Levels> bookAnalyzer(RuntimeParams(200, ITCH_TICK_SCALE), sink.writer());
+        ItchDecoder<BookAnalyzer<Levels>> decoder(bookAnalyzer);
+
+        double run = timed([&] { decoder.decodeStream(capture.data(), capture.size()); sink.writer().flush(); });
+        messages = decoder.stats().messages;
+        return run;
+    });
+    return messages / seconds;
+}
+
+template <class Levels>
+double parseText(const std::string& text, long& events)
+{
+    double seconds = bestOf(3, [&text, &events]
+    {
+        NullSink sink;
+        BookAnalyzer<Levels> bookAnalyzer(RuntimeParams(200), sink.writer());
+        std::istringstream in(text);
+        std::string line;
+        FeedEvent event;
+        events = 0;
+
+        return timed([&]
+        {
+            while (std::getline(in, line) && parseFeedEvent(line, event))
+            {
+                ++events;
+                applyFeedEvent(bookAnalyzer, event);
+            }
+            sink.writer().flush();
+        });
+    });
+    return events / seconds;
+}
+
+int main()
+{
+    FeedParams params;
+    params.events = 2000000;
+    params.modifyRatio = 0.2;
+
+    std::vector<uint8_t> capture;
+    ItchEncoder encoder(capture);
+    std::ostringstream text;
+
+    SyntheticFeed feed(params);
+    FeedEvent event;
+    while (feed.next(event))
+    {
+        encoder.encode(event);
+        SyntheticFeed::write(text, event);
+    }
+
+    long messages = 0;
+    long events = 0;
+    std::printf("%-8s %14s %14s   (messages/s, best of 3, %zu bytes of ITCH)\n", "book", "itch", "text", capture.size());
+    double itch = decodeItch<MapLevels>(capture, messages);
+    std::printf("%-8s %14.0f %14.0f\n", "map", itch, parseText<MapLevels>(text.str(), events));
+    itch = decodeItch<PriceLadder<>>(capture, messages);
+    std::printf("%-8s %14.0f %14.0f\n", "ladder", itch, parseText<PriceLadder<>>(text.str(), events));
+    std::printf("%ld messages, %ld text events\n", messages, events);
+
+    return 0;
+}
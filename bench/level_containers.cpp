@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../price_ladder.h"
+#include "../bplus_tree.h"
+#include "../flat_levels.h"
+#include "bench_util.h"
+
+/*
+Compares the level containers (std::map, price ladder, B+tree, flat arrays) over synthetic feeds of increasing price dispersion.
+The engine output is discarded, the time reported is the whole add/reduce/target walk per event.
+
+Build: g++ -O2 -std=c++17 -o bench_levels bench/level_containers.cpp (add -march=native for the AVX2 B+tree node search)
+Usage: bench_levels [events] [target]
+*/
+
+template <class Levels>
+double replay(const std::vector<FeedEvent>& events, const int target, size_t& levels)
+{
+    BookAnalyzer<Levels> bookAnalyzer(target);
+    double seconds = timed([&] { replayEvents(bookAnalyzer, events); });
+
+    levels = bookAnalyzer.buyMap_.size() + bookAnalyzer.sellMap_.size();
+    return seconds * 1e9 / events.size();
+}
+
+int main(int argc, char** argv)
+{
+    long count = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int target = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    std::cout.setstate(std::ios::badbit); //discard the engine output
+
+    std::printf("%10s %8s %12s %12s %12s %12s\n", "dispersion", "levels", "map ns/ev", "ladder ns/ev", "btree ns/ev", "flat ns/ev");
+
+    for (double dispersion : {1.0, 4.0, 16.0, 64.0, 256.0, 1024.0, 4096.0})
+    {
+        FeedParams params;
+        params.events = count;
+        params.startPrice = 500.0;
+        params.dispersion = dispersion;
+        params.maxOrders = 5000;
+        std::vector<FeedEvent> events = generateEvents(params);
+
+        size_t levels = 0;
+        double map = replay<MapLevels>(events, target, levels);
+        double ladder = replay<PriceLadder<>>(events, target, levels);
+        double btree = replay<BPlusTree<>>(events, target, levels);
+        double flat = replay<FlatLevels>(events, target, levels);
+
+        std::printf("%10.0f %8zu %12.1f %12.1f %12.1f %12.1f\n", dispersion, levels, map, ladder, btree, flat);
+    }
+
+    return 0;
+}
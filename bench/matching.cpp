@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../price_ladder.h"
+#include "bench_util.h"
+
+/*
+Matching throughput on synthetic feeds with a growing share of aggressive (crossing) orders,
+with matching off (crossed orders rest in the book) and on (crossed orders trade against the opposite side).
+The output, trade records included, is formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -o bench_matching bench/matching.cpp
+*/
+
+struct ReplayResult
+{
+    double nsPerEvent;
+    long trades;
+};
+
+template <class Levels>
+ReplayResult replay(const std::vector<FeedEvent>& events, const bool matching)
+{
+    ReplayResult result{0, 0};
+    double seconds = bestOf(3, [&events, matching, &result]
+    {
+        NullSink sink;
+        BookAnalyzer<Levels> bookAnalyzer(RuntimeParams(200), sink.writer());
+        bookAnalyzer.matching_ = matching;
+
+        double run = timed([&] { replayEvents(bookAnalyzer, events); sink.writer().flush(); });
+        result.trades = bookAnalyzer.trades_;
+        return run;
+    });
+    result.nsPerEvent = seconds * 1e9 / events.size();
+    return result;
+}
+
+template <class Levels>
+void compare(const char* name, const double aggressiveRatio, const std::vector<FeedEvent>& events)
+{
+    ReplayResult off = replay<Levels>(events, false);
+    ReplayResult on = replay<Levels>(events, true);
+    std::printf("%-8s %10.2f %12.1f %12.1f %12.0f %12.0f %10ld\n", name, aggressiveRatio, off.nsPerEvent, on.nsPerEvent,
+                1e9 / on.nsPerEvent, on.trades * 1e9 / (on.nsPerEvent * events.size()), on.trades);
+}
+
+int main()
+{
+    std::printf("%-8s %10s %12s %12s %12s %12s %10s   (best of 3)\n", "book", "aggressive", "ns/ev off", "ns/ev on",
+                "events/s on", "trades/s on", "trades");
+
+    for (double aggressiveRatio : {0.0, 0.05, 0.2, 0.5})
+    {
+        FeedParams params;
+        params.events = 1000000;
+        params.aggressiveRatio = aggressiveRatio;
+
+        std::vector<FeedEvent> events = generateEvents(params);
+        compare<MapLevels>("map", aggressiveRatio, events);
+        compare<PriceLadder<>>("ladder", aggressiveRatio, events);
+    }
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../price_ladder.h"
+#include "bench_util.h"
+
+/*
+Native modify events against the same amendments expressed as a full reduce followed by a new add
+(what a feed handler has to send without M), on synthetic feeds with a growing share of modifies.
+Times are per logical event of the M feed, the output is formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -o bench_modify bench/modify.cpp
+*/
+
+//the same feed without M: each modify becomes R (whole remaining size) + A (new price and size, same id)
+std::vector<FeedEvent> withoutModify(const std::vector<FeedEvent>& events)
+{
+    std::vector<FeedEvent> result;
+    std::unordered_map<std::string, FeedEvent> live;
+    for (const FeedEvent& event : events)
+    {
+        if (event.type == 'A')
+        {
+            live[event.id] = event;
+            result.push_back(event);
+        }
+        else if (event.type == 'R')
+        {
+            FeedEvent& order = live[event.id];
+            order.size -= event.size;
+            result.push_back(event);
+        }
+        else
+        {
+            FeedEvent& order = live[event.id];
+            FeedEvent reduce = event;
+            reduce.type = 'R';
+            reduce.size = order.size;
+            result.push_back(reduce);
+
+            order.price = event.price;
+            order.size = event.size;
+            FeedEvent add = order;
+            add.timestamp = event.timestamp;
+            result.push_back(add);
+        }
+    }
+    return result;
+}
+
+template <class Levels>
+double replay(const std::vector<FeedEvent>& events, const size_t logicalEvents)
+{
+    double seconds = bestOf(3, [&events]
+    {
+        NullSink sink;
+        BookAnalyzer<Levels> bookAnalyzer(RuntimeParams(200), sink.writer());
+        return timed([&] { replayEvents(bookAnalyzer, events); sink.writer().flush(); });
+    });
+    return seconds * 1e9 / logicalEvents;
+}
+
+int main()
+{
+    std::printf("%-8s %8s %12s %12s   (ns/event, best of 3)\n", "book", "modify", "M", "R + A");
+
+    for (double modifyRatio : {0.1, 0.3, 0.6})
+    {
+        FeedParams params;
+        params.events = 1000000;
+        params.modifyRatio = modifyRatio;
+
+        std::vector<FeedEvent> events = generateEvents(params);
+        std::vector<FeedEvent> split = withoutModify(events);
+
+        std::printf("%-8s %8.2f %12.1f %12.1f\n", "map", modifyRatio, replay<MapLevels>(events, events.size()),
+                    replay<MapLevels>(split, events.size()));
+        std::printf("%-8s %8.2f %12.1f %12.1f\n", "ladder", modifyRatio, replay<PriceLadder<>>(events, events.size()),
+                    replay<PriceLadder<>>(split, events.size()));
+    }
+
+    return 0;
+}
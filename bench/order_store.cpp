@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../book_analyzer.h"
+#include "../price_ladder.h"
+#include "bench_util.h"
+
+/*
+Cost of a reduce with many live orders: N orders rest on a few thousand levels, then partial reduces of random live orders
+(the orders stay on mkt, the target walk is mostly skipped by the fill boundary) are replayed through applyFeedEvent.
+Reports the best time of 3 passes over the reduces and, when the kernel exposes the hardware counters (perf_event_open),
+the last level cache misses per reduce over the 3 passes.
+The output is formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -o bench_order_store bench/order_store.cpp
+*/
+
+//user space cache miss counter of this thread, -1 when not available
+class CacheMisses
+{
+public:
+
+    CacheMisses()
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~CacheMisses()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    long long read() const
+    {
+        long long count = -1;
+        if (fd_ < 0 || ::read(fd_, &count, sizeof(count)) != sizeof(count))
+            return -1;
+        return count;
+    }
+
+private:
+
+    int fd_;
+};
+
+template <class Levels>
+void run(const char* name, const long orders, const long reduces)
+{
+    NullSink sink;
+    BookAnalyzer<Levels> bookAnalyzer(RuntimeParams(200), sink.writer());
+
+    std::mt19937 rng(1);
+    std::vector<std::string> ids;
+    FeedEvent event;
+    event.type = 'A';
+    for (long i = 0; i < orders; ++i)
+    {
+        event.timestamp = i;
+        event.id = "order" + std::to_string(i);
+        event.side = i % 2 == 0 ? Side::BUY : Side::SELL;
+        event.price = event.side == Side::BUY ? 50.0 - (rng() % 2000) / 100.0 : 50.01 + (rng() % 2000) / 100.0;
+        event.size = 1000000;
+        applyFeedEvent(bookAnalyzer, event);
+        ids.push_back(event.id);
+    }
+
+    std::vector<FeedEvent> events(static_cast<size_t>(reduces));
+    for (FeedEvent& reduce : events)
+    {
+        reduce.type = 'R';
+        reduce.timestamp = orders;
+        reduce.id = ids[rng() % ids.size()];
+        reduce.size = 1;
+    }
+
+    CacheMisses misses;
+    long long missesBefore = misses.read();
+    double seconds = bestOf(3, [&bookAnalyzer, &events] { return timed([&] { replayEvents(bookAnalyzer, events); }); });
+    long long missesAfter = misses.read();
+
+    double ns = seconds * 1e9 / reduces;
+    if (missesBefore >= 0 && missesAfter >= 0)
+        std::printf("%-8s %10ld %12.1f %14.2f\n", name, orders, ns, double(missesAfter - missesBefore) / (3 * reduces));
+    else
+        std::printf("%-8s %10ld %12.1f %14s\n", name, orders, ns, "n/a");
+}
+
+int main()
+{
+    std::printf("%-8s %10s %12s %14s   (2M random partial reduces, best of 3 passes)\n", "book", "orders", "ns/reduce", "misses/reduce");
+
+    for (long orders : {10000L, 100000L, 1000000L, 4000000L})
+    {
+        run<MapLevels>("map", orders, 2000000);
+        run<PriceLadder<>>("ladder", orders, 2000000);
+    }
+
+    return 0;
+}
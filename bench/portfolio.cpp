@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../portfolio.h"
+#include "../price_ladder.h"
+#include "bench_util.h"
+
+/*
+Cost of keeping a portfolio liquidation value up to date: N synthetic instruments (alternately long and short)
+are merged by timestamp and replayed into
+- Portfolio: incremental total, a book only walks its levels when the change is inside the region of its last fill
+- recompute: the same books without evaluation, and after every event the unwind value of every position is walked again
+The portfolio lines are formatted as usual and then discarded.
+
+Build: g++ -O2 -std=c++17 -o bench_portfolio bench/portfolio.cpp
+*/
+
+const long POSITION = 500;
+
+std::vector<FeedEvent> instrumentFeeds(const int instruments, const long eventsPerInstrument)
+{
+    std::vector<FeedEvent> events;
+    for (int instrument = 0; instrument < instruments; ++instrument)
+    {
+        FeedParams params;
+        params.events = eventsPerInstrument;
+        params.startPrice = 20 + instrument;
+        params.seed = static_cast<unsigned>(instrument + 1);
+
+        SyntheticFeed feed(params);
+        FeedEvent event;
+        while (feed.next(event))
+        {
+            event.venue = instrument;
+            events.push_back(event);
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const FeedEvent& a, const FeedEvent& b) { return a.timestamp < b.timestamp; });
+    return events;
+}
+
+long position(const int instrument)
+{
+    return instrument % 2 == 0 ? POSITION : -POSITION;
+}
+
+template <class Levels>
+double incremental(const std::vector<FeedEvent>& events, const int instruments, long& walks)
+{
+    double seconds = bestOf(3, [&events, instruments, &walks]
+    {
+        NullSink sink;
+        Portfolio<Levels> portfolio(sink.writer());
+        for (int i = 0; i < instruments; ++i)
+            portfolio.addInstrument("S" + std::to_string(i), position(i));
+
+        double run = timed([&]
+        {
+            for (const FeedEvent& event : events)
+            {
+                FeedEvent copy = event;
+                copy.venue = 0;
+                portfolio.apply(static_cast<size_t>(event.venue), copy);
+            }
+            sink.writer().flush();
+        });
+
+        walks = 0;
+        for (int i = 0; i < instruments; ++i)
+            walks += portfolio.book(static_cast<size_t>(i)).walks_;
+        return run;
+    });
+    return events.size() / seconds;
+}
+
+template <class Levels>
+double recompute(const std::vector<FeedEvent>& events, const int instruments, long long& checksum)
+{
+    double seconds = bestOf(3, [&events, instruments, &checksum]
+    {
+        std::vector<std::unique_ptr<BookAnalyzer<Levels>>> books;
+        for (int i = 0; i < instruments; ++i)
+        {
+            books.emplace_back(new BookAnalyzer<Levels>(RuntimeParams(POSITION)));
+            books.back()->printLines_ = false;
+            books.back()->evaluate_[Side::BUY] = books.back()->evaluate_[Side::SELL] = false;
+        }
+        checksum = 0;
+
+        return timed([&]
+        {
+            for (const FeedEvent& event : events)
+            {
+                FeedEvent copy = event;
+                copy.venue = 0;
+                applyFeedEvent(*books[static_cast<size_t>(event.venue)], copy);
+
+                long long total = 0;
+                for (int i = 0; i < instruments; ++i)
+                {
+                    BookAnalyzer<Levels>& book = *books[static_cast<size_t>(i)];
+                    FillResult fill = position(i) > 0 ? fillLevels(book.buyMap_, POSITION) : fillLevels(book.sellMap_, POSITION);
+                    total += fill.keyAmount;
+                }
+                checksum += total;
+            }
+        });
+    });
+    return events.size() / seconds;
+}
+
+int main()
+{
+    std::printf("%-8s %12s %14s %14s %14s   (events/s, best of 3, 400k events in total)\n",
+                "book", "instruments", "portfolio", "recompute", "walks/event");
+
+    for (int instruments : {1, 4, 16, 64})
+    {
+        std::vector<FeedEvent> events = instrumentFeeds(instruments, 400000 / instruments);
+        long walks = 0;
+        long long checksum = 0;
+
+        double map = incremental<MapLevels>(events, instruments, walks);
+        std::printf("%-8s %12d %14.0f %14.0f %14.3f\n", "map", instruments, map, recompute<MapLevels>(events, instruments, checksum),
+                    double(walks) / events.size());
+        double ladder = incremental<PriceLadder<>>(events, instruments, walks);
+        std::printf("%-8s %12d %14.0f %14.0f %14.3f\n", "ladder", instruments, ladder,
+                    recompute<PriceLadder<>>(events, instruments, checksum), double(walks) / events.size());
+    }
+
+    return 0;
+}
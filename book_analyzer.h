@@ -0,0 +1,1008 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "book_levels.h"
+#include "order_index.h"
+#include "order_store.h"
+#include "metrics.h"
+#include "output_writer.h"
+#include "probes.h"
+#include "trace.h"
+
+/*
+This implementation keeps 3 separate data structures.
+
+1)
+levels <key : Level>
+Each level is identified by its key (the price in ticks, negated on the Buy side, see book_levels.h).
+Each level holds the aggregated size at that price and the queue of its orders in time priority (level_queue.h),
+with a Fenwick tree over the order sizes so that the size ahead of any order is O(log n) (queuePosition()).
+
+We have one level container for the Buy orders and one for the Sell orders, both keep the levels ordered best-first,
+so that iterating through them we will find always the highest/lowest prices that will be used for expenses/income computation.
+
+The level container is a template parameter of the analyzer:
+- MapLevels (book_levels.h) is a std::map, O(log(n)) per level look-up;
+- PriceLadder (price_ladder.h) is a tick indexed window that follows the touch, O(1) per level look-up near the touch;
+- BPlusTree (bplus_tree.h) is a B+tree with wide nodes and linked leaves, for wide and sparse books.
+- FlatLevels (flat_levels.h) keeps keys and sizes in parallel sorted arrays, the target walk reads them sequentially.
+
+2)
+map <id : handle> and the order store
+The second data structure is an unordered_map where the key is the order id and the value is the handle of the order in the order store
+(order_store.h). The store keeps every order record (side, price in ticks, remaining size and slot in the level queue, and the
+rarely used id, original size and entry timestamp) in one array indexed by the handle; -DBOOK_SPLIT_ORDERS splits the rarely
+used part off into an array of its own. The level queues point to the hot part of the records, which never move.
+The map and the store keep orders in memory as long as there is a corresponding size on mkt for a given order id.
+The id index is the third template parameter (order_index.h): StdOrderIndex (the unordered_map, default), FlatOrderIndex
+(open addressing) or DirectOrderIndex (sequential ids index a vector). Their entries may move on erase, so a position is not kept
+across anything that may drop other orders (a match), the id is looked up again instead.
+
+We can look up the order by id in the hash table (constant time access), and given the price of that order we can go into the Buy or Sell levels
+and look for the price there.
+
+When an order needs to be reduced, we look up the id in the hash table, then find the corresponding level, and finally we reduce the size
+(the order keeps its place in the queue).
+If the size becomes 0, then we remove the order from both data structures, and the level itself if it becomes empty.
+
+Market-by-price feeds (setLevel()) set the aggregated size of a level directly: the level containers and the target walk
+are the same, but there is no order record, so such a book does not pay for the hash table nor the level queues.
+
+A consolidated book (consolidated_) aggregates several venues in the same levels: every order carries its venue tag,
+and next to the consolidated levels each venue has its own levels holding only its sizes (one more level update per event).
+The target walk is unchanged; after it the walk is repeated on the levels it used to split the fill by venue, and a line
+is printed when the amount or the split changes (a venue can take over the shares of another at the same amount).
+
+A modify (modifyOrder()) is a single id look-up and a single target walk: a downsize at the same price is a reduce in place,
+any other change moves the order record from its old level to the back of the new one (cancel-replace, the record itself stays put).
+
+
+This implementation focuses on speed rather than space. Space complextity will be O(n)
+since we have to store in memory all orders as long as there is a size>0 on market.
+
+Time complexity to remove order:
+O(1) (hash table id look-up) +
+O(1) ladder / O(log(n)) map (level look-up) +
+O(log(m)) (size update in the level queue, m orders at that price)
+
+Time complexity to add new order:
+O(1) ladder / O(log(n)) map to insert new level +
+O(1) insert element in hash table +
+O(log(m)) append to the level queue +
+O(k) time to compute new income/expenses, where k is the number of levels needed to fill the target
+(each level keeps its aggregated size, so the orders inside a level are never iterated);
+the walk is skipped altogether when the change is at a price worse than the last level of the previous fill
+
+The best level of each side (price and size) is cached and updated on every add/reduce,
+so best bid/ask, spread and mid are O(1) (top()); the container is asked for the next best only when the best level empties.
+
+The target and the tick scale come from the Params template parameter:
+RuntimeParams holds them as members, FixedParams<Target, TickScale> makes them compile time constants
+for deployments where they are fixed per instrument, so that the compiler can fold them in the target walk
+and in the output formatting.
+
+RuntimeParams may instead carry a notional target (price in ticks times shares): the walk takes whole shares best-first
+while their amount stays within the notional, and the lines report the shares obtained and their average price
+<timestamp> <side> <shares> <average price with 4 decimals>
+NA when the side cannot absorb the whole notional. The boundary skip is the same as for a share target.
+
+Approximate mode (bucketTicks_ > 0, share targets) is for targets deep into the book: next to the levels each side keeps
+price buckets of bucketTicks_ ticks with their aggregated size and size*key, in an array indexed by bucket
+(one more O(1) bucket update per level update), and the walk takes whole buckets from the best one on instead of levels.
+The buckets taken whole are exact, only the shares r taken from the last one are estimated: their keys lie between
+the lowest key of the bucket and the average key of the bucket
+(r shares taken best-first cost at most r times the average), the line prints the middle of that range and its half width
+<timestamp> <side> <amount> <error bound>
+the exact amount is guaranteed to be within amount +- error bound, a line is printed when either of them changes.
+There is no venue split in this mode.
+
+With a price band (bandTicks_ > 0) an order entering more than bandTicks_ ticks behind the best of its side, at a price
+without a level, is kept cold: it stays in hashTable_ (reduces, modifies and queue positions work as usual) and in a per side
+map <key : orders in time priority>, but it is not a level, so stub quotes and fat-finger prices do not grow the level containers.
+Cold orders are always worse than the best by more than the band; they are promoted to the levels (at the back of the queue,
+in time priority) when the best moves back within range of them, and when a target walk would reach their prices
+(or needs their shares), so the output is the same as without the band. Live levels are never demoted.
+*/
+
+struct RuntimeParams
+{
+    RuntimeParams(int target, long tickScale = TICK_SCALE, long long notional = 0) :
+        target_(target), tickScale_(tickScale), notional_(notional)
+    {   }
+
+    int target() const { return target_; }
+    long tickScale() const { return tickScale_; }
+    long long notional() const { return notional_; } //notional target in ticks times shares, 0 for a share target
+
+    int target_;
+    long tickScale_;
+    long long notional_;
+};
+
+template <int Target, long TickScale = TICK_SCALE>
+struct FixedParams
+{
+    static_assert(Target > 0 && TickScale > 0, "target and tick scale must be positive");
+
+    static constexpr int target() { return Target; }
+    static constexpr long tickScale() { return TickScale; }
+    static constexpr long long notional() { return 0; }
+};
+
+template <class Levels = MapLevels, class Params = RuntimeParams, class Index = StdOrderIndex>
+class BookAnalyzer
+{
+public:
+
+    BookAnalyzer(const Params& params = Params(), OutputWriter& out = OutputWriter::standardOutput()) :
+        params_(params), totBuySize_(0), totSellSize_(0), prevExpenses_(0), prevNanExp_(true), prevIncome_(0), prevNanIncome_(true),
+        printTop_(false), matching_(false), trades_(0), consolidated_(false), printLines_(true), evaluate_{true, true}, keepIds_(false), walks_(0),
+        bucketTicks_(0), bandTicks_(0), parked_(0), promoted_(0),
+        boundary_{0, 0}, prevShares_{0, 0}, prevError_{0, 0}, bucketBase_{0, 0}, coldCount_{0, 0}, coldSize_{0, 0}, out_(out)
+    {   }
+
+    Params params_;
+    long totBuySize_;
+    long totSellSize_;
+    long long prevExpenses_; //amounts are kept in ticks
+    bool prevNanExp_;
+    long long prevIncome_;
+    bool prevNanIncome_;
+    bool printTop_; //append the top of book columns to every output line
+    bool matching_; //match incoming orders that cross the opposite side instead of resting them
+    long trades_; //fills emitted in matching mode
+    bool consolidated_; //track the venue contributions of every level and print the venue split of the target fill
+    bool printLines_; //write the amount/NA lines; without them the amounts are only kept in prevExpenses_/prevIncome_
+    bool evaluate_[2]; //sides whose target amount is kept up to date (indexed by Side), both by default
+    bool keepIds_; //keep the order ids in orders_ for takeCheckpoint (matching mode keeps them for the trade records anyway)
+    long walks_; //target walks done, the re-evaluations beyond the fill boundary skip the walk
+    Tick bucketTicks_; //approximate mode: width of the price buckets in ticks, 0 for the exact walk (set before the first event)
+    Tick bandTicks_; //price band: orders entering more than bandTicks_ behind the best of their side are kept cold, 0 for no band
+    long parked_; //orders that entered cold
+    long promoted_; //cold orders promoted to the levels
+
+    //keep levels ordered best-first, so that we can always get the next min/max available
+    Levels buyMap_;
+    Levels sellMap_;
+
+    //also keep all orders id in hash table, for each id we store the handle of the order in orders_, where its hot record holds
+    //the side (to pick the proper levels), the price (to find the level), the remaining size and the slot in the level queue
+    //map <id : handle>
+    Index hashTable_;
+    OrderStore orders_;
+
+
+    void handleNewOrder(const std::string& id, const Side side, const int size, const double price, const long timestamp,
+                        const uint8_t venue = 0)
+    {
+        if (side != Side::BUY && side != Side::SELL)
+            return; //ignore, unknown order type
+
+        Tick tick = priceToTick(price, params_.tickScale());
+        BOOK_PROBE4(add, timestamp, static_cast<int>(side), size, tick);
+        auto inserted = hashTable_.insert(id);
+        if (!inserted.second)
+            return; //ignore, order id already on mkt
+
+        uint32_t handle = orders_.add(OrderInfo{tick, size, 0, 0, side, venue, false}, timestamp);
+        hashTable_.handle(inserted.first) = handle;
+        if (matching_ || keepIds_)
+            orders_.setId(handle, id);
+
+        if (!enter(handle, timestamp))
+            return; //fully filled, nothing rests on mkt
+
+        if (mayFill(side))
+            printTarget(timestamp, side, tickToKey(tick, side));
+    }
+
+    void reduceOrder(const std::string& id, const Side side, const int size, const long timestamp)
+    {
+        auto hashElem = hashTable_.find(id);
+        if (!hashTable_.found(hashElem) || (side != Side::BUY && side != Side::SELL))
+            return; //ignore, order id not found or unknown order type
+
+        BOOK_PROBE3(reduce, timestamp, static_cast<int>(side), size);
+        OrderInfo& order = orders_.hot(hashTable_.handle(hashElem));
+        Levels& book = levels(side);
+        Tick key = tickToKey(order.tick, side);
+        Level* level = order.cold ? nullptr : book.find(key);
+        if (level == nullptr && !order.cold)
+            return;
+
+        if (reduceResting(book, level, key, order, std::min(size, order.size)))
+            drop(hashElem); //remove order id from hashtable since there is no remaining size on market
+
+        printAfterReduce(timestamp, side, key);
+    }
+
+    //set the order to size shares at price, with a single target re-evaluation of its side:
+    //- same price and size not larger: downsized in place, the order keeps its priority;
+    //- otherwise cancel-replace: the order leaves its level and goes to the back of the queue at the new price
+    //  (in matching mode it first trades if the new price crosses the opposite side)
+    //size 0 cancels the order
+    void modifyOrder(const std::string& id, const int size, const double price, const long timestamp)
+    {
+        auto hashElem = hashTable_.find(id);
+        if (!hashTable_.found(hashElem))
+            return; //ignore, order id not found
+
+        OrderInfo& order = orders_.hot(hashTable_.handle(hashElem));
+        const Side side = order.side;
+        Levels& book = levels(side);
+        Tick key = tickToKey(order.tick, side);
+        Level* level = order.cold ? nullptr : book.find(key);
+        if (level == nullptr && !order.cold)
+            return;
+
+        Tick tick = priceToTick(price, params_.tickScale());
+        BOOK_PROBE4(modify, timestamp, static_cast<int>(side), size, tick);
+        if (tick == order.tick && size <= order.size)
+        {
+            if (reduceResting(book, level, key, order, order.size - std::max(size, 0)))
+                drop(hashElem);
+        }
+        else
+        {
+            reduceResting(book, level, key, order, order.size);
+            order.tick = tick;
+            order.size = std::max(size, 0);
+
+            if (order.size > 0 && matching_ && crosses(order))
+                match(order, timestamp);
+
+            if (order.size > 0)
+                rest(order);
+            else
+                drop(hashTable_.find(id)); //the match may have moved the entry of id
+        }
+
+        printAfterReduce(timestamp, side, std::min(key, tickToKey(tick, side)));
+    }
+
+    //the order leaves the mkt and newId enters it on the same side with size shares at price, at the back of the queue
+    //(a replace that also changes the order id, as in ITCH), with a single target re-evaluation
+    void replaceOrder(const std::string& id, const std::string& newId, const int size, const double price, const long timestamp)
+    {
+        auto hashElem = hashTable_.find(id);
+        if (!hashTable_.found(hashElem))
+            return; //ignore, order id not found
+
+        OrderInfo& order = orders_.hot(hashTable_.handle(hashElem));
+        const Side side = order.side;
+        Levels& book = levels(side);
+        Tick key = tickToKey(order.tick, side);
+        Level* level = order.cold ? nullptr : book.find(key);
+        if (level == nullptr && !order.cold)
+            return;
+
+        const Tick tick = priceToTick(price, params_.tickScale());
+        BOOK_PROBE4(modify, timestamp, static_cast<int>(side), size, tick);
+        const uint8_t venue = order.venue;
+        reduceResting(book, level, key, order, order.size);
+        drop(hashElem);
+
+        if (size > 0)
+        {
+            auto inserted = hashTable_.insert(newId);
+            if (inserted.second)
+            {
+                uint32_t handle = orders_.add(OrderInfo{tick, size, 0, 0, side, venue, false}, timestamp);
+                hashTable_.handle(inserted.first) = handle;
+                if (matching_ || keepIds_)
+                    orders_.setId(handle, newId);
+                enter(handle, timestamp);
+            }
+        }
+
+        printAfterReduce(timestamp, side, size > 0 ? std::min(key, tickToKey(tick, side)) : key);
+    }
+
+    //market-by-price update: the level at price now holds size shares in total, 0 removes it.
+    //No order record is kept, a book fed by level updates leaves hashTable_ and the level queues empty
+    //(and queuePosition() has nothing to report); a side must not be fed both orders and levels.
+    //In a consolidated book size is the venue's own size at that price, the level holds the sum over the venues.
+    void setLevel(const Side side, const long size, const double price, const long timestamp, const uint8_t venue = 0)
+    {
+        if (side != Side::BUY && side != Side::SELL)
+            return; //ignore, unknown order type
+
+        Levels& book = levels(side);
+        const Tick tick = priceToTick(price, params_.tickScale());
+        Tick key = tickToKey(tick, side);
+        Level* level = book.find(key);
+        if (level == nullptr && size <= 0)
+            return; //nothing to remove
+
+        BOOK_PROBE4(level, timestamp, static_cast<int>(side), size, tick);
+
+        long previous = level != nullptr ? level->size : 0;
+        long delta = std::max(size, 0L) - (consolidated_ ? venueSize(venue, side, key) : previous);
+        BestLevel& best = best_[side];
+
+        if (consolidated_)
+            addVenueSize(venue, side, key, delta);
+        if (bucketTicks_ > 0)
+            addBucketSize(side, key, delta);
+
+        if (previous + delta <= 0)
+        {
+            book.erase(key);
+            totalSize(side) -= previous;
+            if (key == best.key)
+                refreshBest(side);
+        }
+        else
+        {
+            if (level == nullptr)
+                level = &book.insert(key);
+            level->size = previous + delta;
+            totalSize(side) += delta;
+
+            if (!best.valid || key <= best.key)
+            {
+                best.valid = true;
+                best.key = key;
+                best.size = level->size;
+            }
+        }
+
+        printAfterReduce(timestamp, side, key);
+    }
+
+    //best bid/ask and their sizes, O(1)
+    TopOfBook top() const
+    {
+        TopOfBook top;
+        top.hasBid = best_[Side::BUY].valid;
+        top.bid = keyToTick(best_[Side::BUY].key, Side::BUY);
+        top.bidSize = best_[Side::BUY].size;
+        top.hasAsk = best_[Side::SELL].valid;
+        top.ask = keyToTick(best_[Side::SELL].key, Side::SELL);
+        top.askSize = best_[Side::SELL].size;
+        return top;
+    }
+
+    //size resting ahead of the order at its price level (time priority), -1 if the order is not on mkt, O(log n)
+    long long queuePosition(const std::string& id)
+    {
+        auto hashElem = hashTable_.find(id);
+        if (!hashTable_.found(hashElem))
+            return -1;
+
+        const OrderInfo& order = orders_.hot(hashTable_.handle(hashElem));
+        if (order.cold)
+        {
+            long long ahead = 0;
+            for (const OrderInfo* other : cold_[order.side].find(tickToKey(order.tick, order.side))->second)
+            {
+                if (other == &order)
+                    break;
+                ahead += other->size;
+            }
+            return ahead;
+        }
+
+        Level* level = levels(order.side).find(tickToKey(order.tick, order.side));
+        return level != nullptr ? level->queue.ahead(&order) : -1;
+    }
+
+    //the resting order id, nullptr if it is not on mkt
+    const OrderInfo* findOrder(const std::string& id) const
+    {
+        auto hashElem = hashTable_.find(id);
+        return hashTable_.found(hashElem) ? &orders_.hot(hashTable_.handle(hashElem)) : nullptr;
+    }
+
+    //evaluate both targets again without printing, as if the last lines printed were those of the current book:
+    //after a book was rebuilt with evaluate_ off (a checkpoint restored, see parallel_replay.h) the next events
+    //print what a replay from the start would print
+    void resync()
+    {
+        const bool printLines = printLines_;
+        printLines_ = false;
+        for (const Side side : {Side::BUY, Side::SELL})
+        {
+            (side == Side::BUY ? prevNanExp_ : prevNanIncome_) = true;
+            printAfterReduce(0, side, best_[side].key);
+        }
+        printLines_ = printLines;
+    }
+
+    //orders currently kept cold by the price band, and the prices they are at
+    long coldOrders() const { return static_cast<long>(coldCount_[Side::BUY] + coldCount_[Side::SELL]); }
+    long coldLevels() const { return static_cast<long>(cold_[Side::BUY].size() + cold_[Side::SELL].size()); }
+
+    double tickToPrice(const Tick tick) const
+    {
+        return static_cast<double>(tick) / params_.tickScale();
+    }
+
+private:
+
+    struct BestLevel
+    {
+        bool valid = false;
+        Tick key = 0;
+        long size = 0;
+    };
+
+    Levels& levels(const Side side)
+    {
+        return side == Side::BUY ? buyMap_ : sellMap_;
+    }
+
+    long& totalSize(const Side side)
+    {
+        return side == Side::BUY ? totBuySize_ : totSellSize_;
+    }
+
+    //the order leaves hashTable_ and the store
+    void drop(const typename Index::Position hashElem)
+    {
+        orders_.remove(hashTable_.handle(hashElem));
+        hashTable_.erase(hashElem);
+    }
+
+    //a new order record enters the mkt: in matching mode it first trades if it crosses the opposite side, then what is left rests;
+    //returns false when it was fully filled (and dropped from hashTable_)
+    bool enter(const uint32_t handle, const long timestamp)
+    {
+        OrderInfo& order = orders_.hot(handle);
+
+        if (matching_ && crosses(order))
+        {
+            match(order, timestamp);
+            if (order.size == 0)
+            {
+                drop(hashTable_.find(orders_.record(handle).id)); //the fills may have moved its entry
+                return false;
+            }
+        }
+
+        rest(order);
+        return true;
+    }
+
+    //append the order to the back of the queue at its price level, or to the cold orders at its price when it is beyond the band
+    void rest(OrderInfo& order)
+    {
+        const Side side = order.side;
+        Tick key = tickToKey(order.tick, side);
+        if (bandTicks_ > 0 && best_[side].valid && key > best_[side].key + bandTicks_ && levels(side).find(key) == nullptr)
+        {
+            cold_[side][key].push_back(&order);
+            order.cold = true;
+            ++coldCount_[side];
+            coldSize_[side] += order.size;
+            ++parked_;
+            totalSize(side) += order.size;
+            return;
+        }
+
+        addToLevel(order, key);
+        totalSize(side) += order.size;
+    }
+
+    void addToLevel(OrderInfo& order, const Tick key)
+    {
+        const Side side = order.side;
+        Level& level = levels(side).insert(key);
+        level.queue.push(&order);
+        level.size += order.size;
+        if (consolidated_)
+            addVenueSize(order.venue, side, key, order.size);
+        if (bucketTicks_ > 0)
+            addBucketSize(side, key, order.size);
+
+        BestLevel& best = best_[side];
+        if (!best.valid || key <= best.key)
+        {
+            best.valid = true;
+            best.key = key;
+            best.size = level.size;
+        }
+    }
+
+    //the cold orders at the best cold price of side join the levels
+    void promoteFirst(const Side side)
+    {
+        auto first = cold_[side].begin();
+        for (OrderInfo* order : first->second)
+        {
+            order->cold = false;
+            coldSize_[side] -= order->size;
+            addToLevel(*order, first->first);
+        }
+        coldCount_[side] -= first->second.size();
+        promoted_ += static_cast<long>(first->second.size());
+        cold_[side].erase(first);
+    }
+
+    //keep the cold orders of side beyond the band of the best (all of them join when the levels are empty)
+    void promoteWithinBand(const Side side)
+    {
+        while (!cold_[side].empty() && (!best_[side].valid || cold_[side].begin()->first <= best_[side].key + bandTicks_))
+            promoteFirst(side);
+    }
+
+    //a walk of side that stopped at lastKey, complete or not, has to take the cold orders up to there,
+    //and when it could not fill a target of shares it needs more of them: promote those, true if the walk has to be repeated
+    bool promoteForFill(const Side side, const bool complete, const Tick lastKey, const long target)
+    {
+        std::map<Tick, std::vector<OrderInfo*>>& cold = cold_[side];
+        if (cold.empty() || (complete && lastKey < cold.begin()->first))
+            return false;
+
+        long live = totalSize(side) - coldSize_[side];
+        do
+        {
+            for (const OrderInfo* order : cold.begin()->second)
+                live += order->size;
+            promoteFirst(side);
+        } while (!cold.empty() && (cold.begin()->first <= lastKey || live < target));
+
+        return true;
+    }
+
+    //take reduced shares off a cold order, removed when nothing is left (true in that case)
+    bool reduceCold(OrderInfo& order, const int reduced)
+    {
+        const Side side = order.side;
+        order.size -= reduced;
+        totalSize(side) -= reduced;
+        coldSize_[side] -= reduced;
+        if (order.size > 0)
+            return false;
+
+        auto entry = cold_[side].find(tickToKey(order.tick, side));
+        std::vector<OrderInfo*>& orders = entry->second;
+        orders.erase(std::find(orders.begin(), orders.end(), &order));
+        if (orders.empty())
+            cold_[side].erase(entry);
+        order.cold = false;
+        --coldCount_[side];
+        return true;
+    }
+
+    //take reduced shares off a resting order keeping its priority, the order (and its level if it empties)
+    //is removed when nothing is left; returns true in that case, the caller then drops it from hashTable_
+    bool reduceResting(Levels& book, Level* level, const Tick key, OrderInfo& order, const int reduced)
+    {
+        if (order.cold)
+            return reduceCold(order, reduced);
+
+        const Side side = order.side;
+
+        order.size -= reduced;
+        level->queue.reduce(&order, reduced);
+        level->size -= reduced;
+        totalSize(side) -= reduced;
+        if (consolidated_)
+            addVenueSize(order.venue, side, key, -reduced);
+        if (bucketTicks_ > 0)
+            addBucketSize(side, key, -reduced);
+
+        if (key == best_[side].key)
+            best_[side].size = level->size;
+
+        if (order.size > 0)
+            return false;
+
+        level->queue.remove(&order);
+        if (level->empty())
+        {
+            book.erase(key);
+            if (key == best_[side].key)
+                refreshBest(side);
+        }
+
+        return true;
+    }
+
+    //re-evaluate the target of side after a change at key (the best key when several levels changed)
+    void printAfterReduce(const long timestamp, const Side side, const Tick key)
+    {
+        if (!evaluate_[side])
+            return;
+
+        bool& prevNan = side == Side::BUY ? prevNanExp_ : prevNanIncome_;
+
+        if (mayFill(side))
+            printTarget(timestamp, side, key);
+        else if (prevNan == false)
+            printNA(timestamp, prevNan, side);
+    }
+
+    //the side has enough shares for the target; for a notional target only the walk can tell
+    bool mayFill(const Side side)
+    {
+        return params_.notional() > 0 || params_.target() <= totalSize(side);
+    }
+
+    //the order limit reaches the best level of the opposite side
+    bool crosses(const OrderInfo& order) const
+    {
+        const Side opposite = order.side == Side::BUY ? Side::SELL : Side::BUY;
+        return best_[opposite].valid && best_[opposite].key <= tickToKey(order.tick, opposite);
+    }
+
+    //fill the incoming order against the opposite side with price-time priority, one trade record per fill:
+    //<timestamp> T <aggressor id> <resting id> <price> <size>
+    //the opposite side target is re-evaluated once, after all the fills.
+    //Levels fed by level updates have no order to trade against, they are passed over (what is left of the order
+    //then rests crossing them)
+    void match(OrderInfo& order, const long timestamp)
+    {
+        const Side opposite = order.side == Side::BUY ? Side::SELL : Side::BUY;
+        Levels& book = levels(opposite);
+        const Tick firstKey = best_[opposite].key;
+        const Tick limit = tickToKey(order.tick, opposite);
+
+        while (order.size > 0 && crosses(order))
+        {
+            Tick key = best_[opposite].key;
+            OrderInfo* resting = nullptr;
+            book.forEach([&key, &resting, limit](const Tick levelKey, const Level& level)
+            {
+                if (levelKey > limit)
+                    return false;
+                key = levelKey;
+                resting = level.queue.front();
+                return resting == nullptr;
+            });
+            if (resting == nullptr)
+                break;
+
+            Level* level = book.find(key);
+            int fill = std::min(order.size, resting->size);
+
+            const std::string& restingId = orders_.record(resting->handle).id;
+            out_.writeTrade(timestamp, orders_.record(order.handle).id, restingId, keyToTick(key, opposite), fill, params_.tickScale());
+            out_.endLine();
+            ++trades_;
+
+            order.size -= fill;
+            if (reduceResting(book, level, key, *resting, fill))
+                drop(hashTable_.find(restingId));
+        }
+
+        printAfterReduce(timestamp, opposite, firstKey);
+    }
+
+    void printNA(const long timestamp, bool& prevNan, Side side)
+    {
+        prevNan = true;
+        Metrics::count(Metric::NA_TRANSITIONS);
+        if (!printLines_)
+            return;
+
+        BOOK_PROBE2(print_na, timestamp, static_cast<int>(side));
+        out_.writeNA(timestamp, side == Side::BUY ? 'S' : 'B');
+        endLine();
+    }
+
+    void print(const long long amount, long long& prevAmount, bool& prevIsNan, const long timestamp, const Side side)
+    {
+        bool splitChanged = printLines_ && consolidated_ && splitVenues(side, params_.target());
+        if (printLines_ && (amount != prevAmount || splitChanged || prevIsNan == true))
+        {
+            BOOK_PROBE3(print, timestamp, static_cast<int>(side), amount);
+            out_.writeAmount(timestamp, side == Side::BUY ? 'S' : 'B', amount, params_.tickScale());
+            if (consolidated_)
+                printVenueSplit();
+            endLine();
+        }
+
+        prevAmount = amount;
+        prevIsNan = false;
+    }
+
+    void endLine()
+    {
+        if (printTop_)
+            out_.writeTop(top(), params_.tickScale());
+        out_.endLine();
+    }
+
+    //the best level of a side went away: ask the container for the new one
+    void refreshBest(const Side side)
+    {
+        Levels& book = levels(side);
+        BestLevel& best = best_[side];
+
+        best.valid = !book.empty();
+        best.key = best.valid ? book.bestKey() : 0;
+        best.size = best.valid ? book.find(best.key)->size : 0;
+
+        if (!cold_[side].empty())
+            promoteWithinBand(side);
+    }
+
+    //walk the levels best-first until the target shares are filled: selling into the Buy side gives the income,
+    //buying from the Sell side gives the expenses.
+    //A change at a key worse than the last level of the previous fill (the boundary) leaves the fill as it was,
+    //then the walk is skipped: the amount would be the same and nothing would be printed.
+    void printTarget(const long timestamp, const Side side, const Tick key)
+    {
+        bool prevNan = side == Side::BUY ? prevNanExp_ : prevNanIncome_;
+        if (!evaluate_[side] || (!prevNan && key > boundary_[side]))
+            return;
+
+        TRACE_SAMPLED_SCOPE("target walk");
+        BOOK_PROBE2(walk_start, timestamp, static_cast<int>(side));
+        if (params_.notional() > 0)
+        {
+            printNotional(timestamp, side);
+            return;
+        }
+        if (bucketTicks_ > 0)
+        {
+            printApproximate(timestamp, side);
+            return;
+        }
+
+        FillResult fill = fillLevels(levels(side), params_.target());
+        while (promoteForFill(side, fill.filled == params_.target(), fill.lastKey, params_.target()))
+            fill = fillLevels(levels(side), params_.target());
+        long long amount = side == Side::BUY ? -fill.keyAmount : fill.keyAmount;
+        boundary_[side] = fill.lastKey;
+        ++walks_;
+        BOOK_PROBE4(walk_end, timestamp, static_cast<int>(side), fill.levels, fill.filled);
+
+        if (side == Side::BUY)
+            print(amount, prevExpenses_, prevNanExp_, timestamp, side);
+        else
+            print(amount, prevIncome_, prevNanIncome_, timestamp, side);
+    }
+
+    //notional target: the shares its amount obtains on side and their average price, printed when either changes
+    void printNotional(const long timestamp, const Side side)
+    {
+        NotionalFill fill = fillNotional(levels(side), params_.notional());
+        while (promoteForFill(side, fill.complete, fill.lastKey, 0))
+            fill = fillNotional(levels(side), params_.notional());
+        boundary_[side] = fill.lastKey;
+        ++walks_;
+        BOOK_PROBE4(walk_end, timestamp, static_cast<int>(side), fill.levels, fill.filled);
+
+        bool& prevNan = side == Side::BUY ? prevNanExp_ : prevNanIncome_;
+        long long& prevAmount = side == Side::BUY ? prevExpenses_ : prevIncome_;
+        if (!fill.complete)
+        {
+            if (!prevNan)
+                printNA(timestamp, prevNan, side);
+            return;
+        }
+
+        long long amount = side == Side::BUY ? -fill.keyAmount : fill.keyAmount;
+        bool splitChanged = printLines_ && consolidated_ && splitVenues(side, fill.filled);
+        if (printLines_ && (fill.filled != prevShares_[side] || amount != prevAmount || splitChanged || prevNan))
+        {
+            BOOK_PROBE3(print, timestamp, static_cast<int>(side), amount);
+            out_.writeNotionalFill(timestamp, side == Side::BUY ? 'S' : 'B', fill.filled, amount, params_.tickScale());
+            if (consolidated_)
+                printVenueSplit();
+            endLine();
+        }
+
+        prevShares_[side] = fill.filled;
+        prevAmount = amount;
+        prevNan = false;
+    }
+
+    //approximate mode: walk the buckets best-first, the last one taken in part is estimated (see the design notes above)
+    void printApproximate(const long timestamp, const Side side)
+    {
+        const long target = params_.target();
+        long filled = 0;
+        long long keyAmount = 0;
+        long long error = 0;
+        bool complete = false;
+        long scanned = 0;
+
+        do
+        {
+            filled = 0;
+            keyAmount = 0;
+            error = 0;
+            complete = false;
+            scanned = 0;
+
+            const std::vector<Bucket>& buckets = buckets_[side];
+            for (size_t i = static_cast<size_t>(floorDiv(best_[side].key, bucketTicks_) - bucketBase_[side]); i < buckets.size(); ++i)
+            {
+                const Bucket& bucket = buckets[i];
+                const Tick index = bucketBase_[side] + static_cast<Tick>(i);
+                boundary_[side] = index * bucketTicks_ + bucketTicks_ - 1;
+                ++scanned;
+                if (bucket.size <= target - filled)
+                {
+                    filled += bucket.size;
+                    keyAmount += bucket.keySize;
+                    complete = filled == target;
+                    if (complete)
+                        break;
+                    continue;
+                }
+
+                long long shares = target - filled;
+                long long lower = shares * (index * bucketTicks_);
+                long long upper = shares * ceilDiv(bucket.keySize, bucket.size);
+                keyAmount += lower + (upper - lower) / 2;
+                error = upper - lower - (upper - lower) / 2;
+                complete = true;
+                break;
+            }
+        } while (promoteForFill(side, complete, boundary_[side], target));
+        ++walks_;
+        BOOK_PROBE4(walk_end, timestamp, static_cast<int>(side), scanned, filled);
+
+        long long amount = side == Side::BUY ? -keyAmount : keyAmount;
+        bool& prevNan = side == Side::BUY ? prevNanExp_ : prevNanIncome_;
+        long long& prevAmount = side == Side::BUY ? prevExpenses_ : prevIncome_;
+        if (printLines_ && (amount != prevAmount || error != prevError_[side] || prevNan))
+        {
+            BOOK_PROBE3(print, timestamp, static_cast<int>(side), amount);
+            out_.writeAmount(timestamp, side == Side::BUY ? 'S' : 'B', amount, params_.tickScale());
+            out_.writeErrorBound(error, params_.tickScale());
+            endLine();
+        }
+
+        prevError_[side] = error;
+        prevAmount = amount;
+        prevNan = false;
+    }
+
+    static long long floorDiv(const long long a, const long long b)
+    {
+        return a / b - (a % b != 0 && (a < 0) != (b < 0));
+    }
+
+    static long long ceilDiv(const long long a, const long long b)
+    {
+        return -floorDiv(-a, b);
+    }
+
+    //the bucket array of a side covers the buckets seen so far, it grows (at least doubling) towards new ones and never shrinks
+    void addBucketSize(const Side side, const Tick key, const long delta)
+    {
+        std::vector<Bucket>& buckets = buckets_[side];
+        Tick index = floorDiv(key, bucketTicks_);
+        if (buckets.empty())
+            bucketBase_[side] = index;
+
+        if (index < bucketBase_[side])
+        {
+            Tick grow = std::max<Tick>(bucketBase_[side] - index, static_cast<Tick>(buckets.size()));
+            buckets.insert(buckets.begin(), static_cast<size_t>(grow), Bucket());
+            bucketBase_[side] -= grow;
+        }
+        else if (index - bucketBase_[side] >= static_cast<Tick>(buckets.size()))
+        {
+            buckets.resize(std::max(static_cast<size_t>(index - bucketBase_[side]) + 1, 2 * buckets.size()));
+        }
+
+        Bucket& bucket = buckets[static_cast<size_t>(index - bucketBase_[side])];
+        bucket.size += delta;
+        bucket.keySize += delta * key;
+    }
+
+    //the levels of one venue and side in a consolidated book, created on first use; they only hold sizes
+    Levels& venueLevels(const uint8_t venue, const Side side)
+    {
+        size_t index = 2 * venue + side;
+        if (index >= venueLevels_.size())
+            venueLevels_.resize(index + 2);
+        if (!venueLevels_[index])
+            venueLevels_[index].reset(new Levels());
+        return *venueLevels_[index];
+    }
+
+    long venueSize(const uint8_t venue, const Side side, const Tick key)
+    {
+        size_t index = 2 * venue + side;
+        if (index >= venueLevels_.size() || !venueLevels_[index])
+            return 0;
+        const Level* level = venueLevels_[index]->find(key);
+        return level != nullptr ? level->size : 0;
+    }
+
+    void addVenueSize(const uint8_t venue, const Side side, const Tick key, const long delta)
+    {
+        Levels& book = venueLevels(venue, side);
+        Level& level = book.insert(key);
+        level.size += delta;
+        if (level.size <= 0)
+            book.erase(key);
+    }
+
+    //the venue split of the target fill of side into venueShares_ and venueAmounts_, true when it differs from the previous split
+    //of that side. Levels taken whole give each venue its own size there; the last level, taken in part, is split pro rata
+    //to the venue sizes (largest remainder first, lower venue first on ties)
+    bool splitVenues(const Side side, const long target)
+    {
+        const size_t venues = venueLevels_.size() / 2;
+        venueShares_.assign(venues, 0);
+        venueAmounts_.assign(venues, 0);
+        venueRemainders_.resize(venues);
+
+        long remaining = target;
+        levels(side).forEach([&](const Tick key, const Level& level)
+        {
+            long take = std::min(level.size, remaining);
+            Tick tick = keyToTick(key, side);
+            long given = 0;
+
+            for (size_t venue = 0; venue < venues; ++venue)
+            {
+                long size = venueSize(static_cast<uint8_t>(venue), side, key);
+                long shares = take == level.size ? size : take * size / level.size;
+                venueRemainders_[venue] = take == level.size ? 0 : take * size % level.size;
+                venueShares_[venue] += shares;
+                venueAmounts_[venue] += static_cast<long long>(shares) * tick;
+                given += shares;
+            }
+
+            for (; given < take; ++given)
+            {
+                size_t top = static_cast<size_t>(std::max_element(venueRemainders_.begin(), venueRemainders_.end()) - venueRemainders_.begin());
+                venueRemainders_[top] = -1;
+                ++venueShares_[top];
+                venueAmounts_[top] += tick;
+            }
+
+            remaining -= take;
+            return remaining > 0;
+        });
+
+        if (venueShares_ == prevVenueShares_[side] && venueAmounts_ == prevVenueAmounts_[side])
+            return false;
+        prevVenueShares_[side] = venueShares_;
+        prevVenueAmounts_[side] = venueAmounts_;
+        return true;
+    }
+
+    //after the consolidated amount: " v<venue> <shares> <amount>" for every venue the last split gives shares to
+    void printVenueSplit()
+    {
+        for (size_t venue = 0; venue < venueShares_.size(); ++venue)
+        {
+            if (venueShares_[venue] > 0)
+                out_.writeVenueFill(static_cast<int>(venue), venueShares_[venue], venueAmounts_[venue], params_.tickScale());
+        }
+    }
+
+    BestLevel best_[2];
+    Tick boundary_[2]; //key of the last level taken by the previous fill of each side
+    long prevShares_[2]; //notional target: shares of the previous fill of each side
+    long long prevError_[2]; //approximate mode: error bound of the previous amount of each side, in ticks
+
+    struct Bucket
+    {
+        long size = 0;
+        long long keySize = 0;
+    };
+    //approximate mode: the buckets of each side, bucket i holds the keys from (bucketBase_ + i) * bucketTicks_ on
+    std::vector<Bucket> buckets_[2];
+    Tick bucketBase_[2];
+
+    std::map<Tick, std::vector<OrderInfo*>> cold_[2]; //price band: key to the cold orders at that price in time priority, per side
+    size_t coldCount_[2];
+    long coldSize_[2];
+    std::vector<std::unique_ptr<Levels>> venueLevels_; //consolidated book: 2 * venue + side
+    std::vector<long> venueShares_;
+    std::vector<long long> venueAmounts_;
+    std::vector<long> venueRemainders_;
+    std::vector<long> prevVenueShares_[2]; //consolidated book: the previous venue split of each side
+    std::vector<long long> prevVenueAmounts_[2];
+    OutputWriter& out_;
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "level_queue.h"
+
+/*
+Common types shared by the book engine and the level containers.
+
+Prices are handled as integer ticks (price * tick scale, TICK_SCALE by default) so that levels can be indexed directly
+and amounts can be accumulated without floating point drift.
+A price that is not a whole number of ticks is rounded to the nearest tick (priceToTick) without notice: with the default
+scale (cents) 10.004 and 10.00 are the same level and the amounts differ from those of the exact prices.
+Feeds with finer prices need a finer scale (book_analyzer --tick-scale, ITCH feeds use ITCH_TICK_SCALE).
+
+Every level container stores its levels keyed by a "key" that is always ordered best-first ascending:
+for the Sell side the key is the tick itself (lowest ask first), for the Buy side the key is the negated tick
+(highest bid first). This way a single container type serves both sides and there is no parallel code
+with different comparators.
+*/
+
+typedef long Tick;
+
+const long TICK_SCALE = 100;
+
+enum Side : uint8_t {
+    BUY = 0,
+    SELL,
+    UNKNOWN
+};
+
+inline Tick priceToTick(const double price, const long scale = TICK_SCALE)
+{
+    return std::llround(price * scale);
+}
+
+inline Tick tickToKey(const Tick tick, const Side side)
+{
+    return side == Side::BUY ? -tick : tick;
+}
+
+inline Tick keyToTick(const Tick key, const Side side)
+{
+    return side == Side::BUY ? -key : key;
+}
+
+//the part of a resting order used on the add/reduce path (see order_store.h), 24 bytes:
+//tick and side locate its level, seq is its slot in the level queue and handle its index in the order store;
+//venue is the venue tag in a consolidated book (0 otherwise);
+//a cold order is outside the price band of the book and kept off the levels (see BookAnalyzer::bandTicks_)
+struct OrderInfo
+{
+    Tick tick;
+    int size;
+    uint32_t seq;
+    uint32_t handle;
+    Side side;
+    uint8_t venue;
+    bool cold;
+};
+
+//one price level: the aggregated size of all the orders at this price and the orders themselves in time priority
+struct Level
+{
+    long size = 0;
+    LevelQueue<OrderInfo> queue;
+
+    bool empty() const { return size == 0 && queue.empty(); }
+
+    void clear()
+    {
+        size = 0;
+        queue.clear();
+    }
+};
+
+//best bid/ask (in ticks) and their sizes, sizes are 0 when the side is empty
+struct TopOfBook
+{
+    bool hasBid = false;
+    bool hasAsk = false;
+    Tick bid = 0;
+    Tick ask = 0;
+    long bidSize = 0;
+    long askSize = 0;
+
+    Tick spread() const { return ask - bid; }
+    double mid() const { return (bid + ask) / 2.0; }
+};
+
+//result of a target walk: shares filled, sum of size*key over the levels taken, the key of the last (worst) level taken
+//and the number of levels taken
+struct FillResult
+{
+    long filled = 0;
+    long long keyAmount = 0;
+    Tick lastKey = 0;
+    long levels = 0;
+};
+
+//fill of a notional target: the whole shares whose amount (price in ticks times shares) stays within the notional;
+//complete when the walk stopped inside the book, i.e. one more share would exceed the notional or it is spent exactly
+struct NotionalFill
+{
+    long filled = 0;
+    long long keyAmount = 0;
+    Tick lastKey = 0;
+    bool complete = false;
+    long long remaining = 0; //notional left
+    long levels = 0; //levels taken
+
+    //take what fits of a level, false when the walk is over
+    bool take(const Tick key, const long size)
+    {
+        long long price = key < 0 ? -key : key;
+        long shares = price > 0 ? static_cast<long>(std::min<long long>(size, remaining / price)) : size;
+        keyAmount += static_cast<long long>(shares) * key;
+        filled += shares;
+        remaining -= static_cast<long long>(shares) * price;
+        lastKey = key;
+        ++levels;
+        complete = shares < size || remaining == 0;
+        return !complete;
+    }
+};
+
+/*
+Level container backed by std::map <key : Level>.
+This is the original layout of the analyzer and it is also used as the ordered overflow of the price ladder.
+*/
+class MapLevels
+{
+public:
+
+    Level* find(const Tick key)
+    {
+        auto iter = levels_.find(key);
+        return iter != levels_.end() ? &iter->second : nullptr;
+    }
+
+    //return the level for key, creating an empty one if it doesn't exist
+    Level& insert(const Tick key)
+    {
+        return levels_[key];
+    }
+
+    void insert(const Tick key, Level&& level)
+    {
+        levels_.emplace(key, std::move(level));
+    }
+
+    void erase(const Tick key)
+    {
+        levels_.erase(key);
+    }
+
+    bool empty() const { return levels_.empty(); }
+    size_t size() const { return levels_.size(); }
+
+    Tick bestKey() const { return levels_.begin()->first; }
+
+    //remove the best level and hand it over to the caller
+    Level popBest()
+    {
+        auto iter = levels_.begin();
+        Level level = std::move(iter->second);
+        levels_.erase(iter);
+        return level;
+    }
+
+    //visit levels best-first until f(key, level) returns false
+    template <class F>
+    void forEach(F&& f) const
+    {
+        for (auto it = levels_.begin(); it != levels_.end(); ++it)
+        {
+            if (!f(it->first, it->second))
+                return;
+        }
+    }
+
+private:
+
+    std::map<Tick, Level> levels_;
+};
+
+//take levels best-first until target shares are filled, containers with aggregated sizes provide their own overload
+template <class Levels>
+FillResult fillLevels(const Levels& levels, const long target)
+{
+    FillResult result;
+
+    levels.forEach([&](const Tick key, const Level& level)
+    {
+        long localSize = std::min(level.size, target - result.filled);
+        result.keyAmount += localSize * key;
+        result.filled += localSize;
+        result.lastKey = key;
+        ++result.levels;
+        return result.filled < target;
+    });
+
+    return result;
+}
+
+//take levels best-first until the notional is spent, containers with aggregated amounts provide their own overload
+template <class Levels>
+NotionalFill fillNotional(const Levels& levels, const long long notional)
+{
+    NotionalFill result;
+    result.remaining = notional;
+
+    levels.forEach([&](const Tick key, const Level& level)
+    {
+        return result.take(key, level.size);
+    });
+
+    return result;
+}
@@ -0,0 +1,497 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "book_levels.h"
+
+/*
+B+tree level container for wide, sparse books.
+
+Nodes are wide (LeafCapacity/InnerCapacity keys) and keep their keys in a separate fixed size array,
+padded with KEY_PAD, so that a node search is a branch free count of the keys lower than the searched one
+over the whole array (AVX2 compares when compiled with -mavx2/-march=native, a loop the compiler vectorizes otherwise).
+A look-up touches one cache line of keys per level of the tree instead of one node per level of a red-black tree.
+
+Leaves are linked in key order, so best-first iteration is a walk along the leaves starting from head_.
+Each leaf also keeps the aggregated size and size*key of its levels, the target walks (fillLevels, fillNotional) take whole leaves
+at once while the target is not reached. Since the engine updates level sizes in place, the aggregates are refreshed
+lazily: find/insert/erase mark the leaf dirty, and the walk recomputes only the dirty leaves.
+The aggregates are mutable, a cache that fill/fillNotional refresh although they are const: a tree must not be walked
+from two threads at once, not even through const references.
+
+Empty leaves and inner nodes are freed and unlinked, underfull nodes are not merged (levels keep coming back around the touch).
+*/
+
+template <size_t LeafCapacity = 32, size_t InnerCapacity = 32>
+class BPlusTree
+{
+    static_assert(LeafCapacity % 4 == 0 && InnerCapacity % 4 == 0 && LeafCapacity >= 4 && InnerCapacity >= 4,
+                  "node capacities must be multiples of 4");
+
+    static constexpr Tick KEY_PAD = std::numeric_limits<Tick>::max();
+
+    struct Leaf
+    {
+        Leaf() : count(0), prev(nullptr), next(nullptr), sumSize(0), sumKeySize(0), dirty(false)
+        {
+            for (size_t i = 0; i < LeafCapacity; ++i)
+                keys[i] = KEY_PAD;
+        }
+
+        size_t count;
+        Tick keys[LeafCapacity];
+        Level values[LeafCapacity];
+        Leaf* prev;
+        Leaf* next;
+        mutable long sumSize; //aggregates, valid when not dirty
+        mutable long long sumKeySize;
+        mutable bool dirty;
+    };
+
+    struct Inner
+    {
+        Inner() : count(0)
+        {
+            for (size_t i = 0; i < InnerCapacity; ++i)
+                keys[i] = KEY_PAD;
+        }
+
+        size_t count; //number of keys, children are count+1
+        Tick keys[InnerCapacity]; //keys[i] is the first key of children[i+1]
+        void* children[InnerCapacity + 1];
+    };
+
+    struct PathEntry
+    {
+        Inner* node;
+        size_t child;
+    };
+
+    static const int MAX_HEIGHT = 32;
+
+public:
+
+    BPlusTree() : root_(new Leaf()), height_(0), size_(0)
+    {
+        head_ = static_cast<Leaf*>(root_);
+    }
+
+    ~BPlusTree()
+    {
+        destroy(root_, height_);
+    }
+
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    Level* find(const Tick key)
+    {
+        Leaf* leaf = findLeaf(key, nullptr);
+        size_t pos = lowerBound<LeafCapacity>(leaf->keys, key);
+        if (pos >= leaf->count || leaf->keys[pos] != key)
+            return nullptr;
+
+        leaf->dirty = true;
+        return &leaf->values[pos];
+    }
+
+    //return the level for key, creating an empty one if it doesn't exist
+    Level& insert(const Tick key)
+    {
+        PathEntry path[MAX_HEIGHT];
+        Leaf* leaf = findLeaf(key, path);
+        size_t pos = lowerBound<LeafCapacity>(leaf->keys, key);
+
+        if (pos < leaf->count && leaf->keys[pos] == key)
+        {
+            leaf->dirty = true;
+            return leaf->values[pos];
+        }
+
+        ++size_;
+
+        if (leaf->count == LeafCapacity)
+        {
+            //split: the upper half moves to a new leaf on the right
+            Leaf* right = new Leaf();
+            size_t half = LeafCapacity / 2;
+            for (size_t i = half; i < LeafCapacity; ++i)
+            {
+                right->keys[i - half] = leaf->keys[i];
+                right->values[i - half] = std::move(leaf->values[i]);
+                leaf->keys[i] = KEY_PAD;
+                leaf->values[i] = Level();
+            }
+            right->count = LeafCapacity - half;
+            leaf->count = half;
+
+            right->prev = leaf;
+            right->next = leaf->next;
+            if (leaf->next != nullptr)
+                leaf->next->prev = right;
+            leaf->next = right;
+
+            insertInParent(path, right->keys[0], right);
+
+            leaf->dirty = true;
+            right->dirty = true;
+            if (pos > half)
+            {
+                leaf = right;
+                pos -= half;
+            }
+        }
+
+        for (size_t i = leaf->count; i > pos; --i)
+        {
+            leaf->keys[i] = leaf->keys[i - 1];
+            leaf->values[i] = std::move(leaf->values[i - 1]);
+        }
+
+        leaf->keys[pos] = key;
+        leaf->values[pos] = Level();
+        ++leaf->count;
+        leaf->dirty = true;
+
+        return leaf->values[pos];
+    }
+
+    void insert(const Tick key, Level&& level)
+    {
+        insert(key) = std::move(level);
+    }
+
+    void erase(const Tick key)
+    {
+        PathEntry path[MAX_HEIGHT];
+        Leaf* leaf = findLeaf(key, path);
+        size_t pos = lowerBound<LeafCapacity>(leaf->keys, key);
+        if (pos >= leaf->count || leaf->keys[pos] != key)
+            return;
+
+        --size_;
+        --leaf->count;
+        for (size_t i = pos; i < leaf->count; ++i)
+        {
+            leaf->keys[i] = leaf->keys[i + 1];
+            leaf->values[i] = std::move(leaf->values[i + 1]);
+        }
+        leaf->keys[leaf->count] = KEY_PAD;
+        leaf->values[leaf->count] = Level();
+        leaf->dirty = true;
+
+        if (leaf->count == 0 && height_ > 0)
+            removeLeaf(leaf, path);
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    Tick bestKey() const { return head_->keys[0]; }
+
+    //remove the best level and hand it over to the caller
+    Level popBest()
+    {
+        Tick key = head_->keys[0];
+        Level level = std::move(head_->values[0]);
+        erase(key);
+        return level;
+    }
+
+    //visit levels best-first until f(key, level) returns false
+    template <class F>
+    void forEach(F&& f) const
+    {
+        for (const Leaf* leaf = head_; leaf != nullptr; leaf = leaf->next)
+        {
+            for (size_t i = 0; i < leaf->count; ++i)
+            {
+                if (!f(leaf->keys[i], static_cast<const Level&>(leaf->values[i])))
+                    return;
+            }
+        }
+    }
+
+    //take levels best-first until target shares are filled, whole leaves at once when they fit
+    FillResult fill(const long target) const
+    {
+        FillResult result;
+
+        for (const Leaf* leaf = head_; leaf != nullptr && result.filled < target; leaf = leaf->next)
+        {
+            if (leaf->dirty)
+                refresh(leaf);
+
+            if (leaf->sumSize <= target - result.filled)
+            {
+                result.filled += leaf->sumSize;
+                result.keyAmount += leaf->sumKeySize;
+                result.levels += static_cast<long>(leaf->count);
+                if (leaf->count > 0)
+                    result.lastKey = leaf->keys[leaf->count - 1];
+                continue;
+            }
+
+            for (size_t i = 0; i < leaf->count && result.filled < target; ++i)
+            {
+                long localSize = std::min(leaf->values[i].size, target - result.filled);
+                result.keyAmount += localSize * leaf->keys[i];
+                result.filled += localSize;
+                result.lastKey = leaf->keys[i];
+                ++result.levels;
+            }
+        }
+
+        return result;
+    }
+
+    //take levels best-first until the notional is spent, whole leaves at once when their amount is below what is left
+    NotionalFill fillNotional(const long long notional) const
+    {
+        NotionalFill result;
+        result.remaining = notional;
+
+        for (const Leaf* leaf = head_; leaf != nullptr; leaf = leaf->next)
+        {
+            if (leaf->dirty)
+                refresh(leaf);
+
+            long long amount = leaf->sumKeySize < 0 ? -leaf->sumKeySize : leaf->sumKeySize; //the keys of a side share their sign
+            if (amount < result.remaining)
+            {
+                result.filled += leaf->sumSize;
+                result.keyAmount += leaf->sumKeySize;
+                result.remaining -= amount;
+                result.levels += static_cast<long>(leaf->count);
+                if (leaf->count > 0)
+                    result.lastKey = leaf->keys[leaf->count - 1];
+                continue;
+            }
+
+            for (size_t i = 0; i < leaf->count; ++i)
+            {
+                if (!result.take(leaf->keys[i], leaf->values[i].size))
+                    return result;
+            }
+        }
+
+        return result;
+    }
+
+private:
+
+    //number of keys lower than key in a KEY_PAD padded sorted array, i.e. the lower bound
+    template <size_t N>
+    static size_t lowerBound(const Tick* keys, const Tick key)
+    {
+#if defined(__AVX2__)
+        const __m256i needle = _mm256_set1_epi64x(key);
+        size_t count = 0;
+        for (size_t i = 0; i < N; i += 4)
+        {
+            __m256i lower = _mm256_cmpgt_epi64(needle, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)));
+            count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(lower)));
+        }
+        return count;
+#else
+        size_t count = 0;
+        for (size_t i = 0; i < N; ++i)
+            count += keys[i] < key;
+        return count;
+#endif
+    }
+
+    //descend to the leaf that holds key, recording the path if requested
+    Leaf* findLeaf(const Tick key, PathEntry* path) const
+    {
+        void* node = root_;
+        for (int h = height_; h > 0; --h)
+        {
+            Inner* inner = static_cast<Inner*>(node);
+            //child index is the number of separators <= key
+            size_t child = key == KEY_PAD ? inner->count : lowerBound<InnerCapacity>(inner->keys, key + 1);
+            if (path != nullptr)
+                path[height_ - h] = PathEntry{inner, child};
+            node = inner->children[child];
+        }
+
+        return static_cast<Leaf*>(node);
+    }
+
+    //insert separator/right child after path's child at the deepest inner level, splitting upwards as needed
+    void insertInParent(PathEntry* path, Tick separator, void* right)
+    {
+        for (int depth = height_ - 1; depth >= 0; --depth)
+        {
+            Inner* inner = path[depth].node;
+            size_t pos = path[depth].child;
+
+            if (inner->count < InnerCapacity)
+            {
+                insertSeparator(inner, pos, separator, right);
+                return;
+            }
+
+            //split: keys after the middle move to a new inner node, the middle key goes up
+            Inner* sibling = new Inner();
+            Tick keys[InnerCapacity + 1];
+            void* children[InnerCapacity + 2];
+
+            for (size_t i = 0, j = 0; i <= InnerCapacity; ++i)
+            {
+                if (i == pos)
+                    keys[i] = separator;
+                else
+                    keys[i] = inner->keys[j++];
+            }
+            for (size_t i = 0, j = 0; i <= InnerCapacity + 1; ++i)
+            {
+                if (i == pos + 1)
+                    children[i] = right;
+                else
+                    children[i] = inner->children[j++];
+            }
+
+            size_t mid = (InnerCapacity + 1) / 2;
+            inner->count = mid;
+            for (size_t i = 0; i < InnerCapacity; ++i)
+                inner->keys[i] = i < mid ? keys[i] : KEY_PAD;
+            for (size_t i = 0; i <= mid; ++i)
+                inner->children[i] = children[i];
+
+            sibling->count = InnerCapacity - mid;
+            for (size_t i = 0; i < sibling->count; ++i)
+                sibling->keys[i] = keys[mid + 1 + i];
+            for (size_t i = 0; i <= sibling->count; ++i)
+                sibling->children[i] = children[mid + 1 + i];
+
+            separator = keys[mid];
+            right = sibling;
+        }
+
+        //the root was split (or was a leaf): grow the tree by one level
+        Inner* newRoot = new Inner();
+        newRoot->count = 1;
+        newRoot->keys[0] = separator;
+        newRoot->children[0] = root_;
+        newRoot->children[1] = right;
+        root_ = newRoot;
+        ++height_;
+    }
+
+    static void insertSeparator(Inner* inner, const size_t pos, const Tick separator, void* right)
+    {
+        for (size_t i = inner->count; i > pos; --i)
+        {
+            inner->keys[i] = inner->keys[i - 1];
+            inner->children[i + 1] = inner->children[i];
+        }
+
+        inner->keys[pos] = separator;
+        inner->children[pos + 1] = right;
+        ++inner->count;
+    }
+
+    void removeLeaf(Leaf* leaf, PathEntry* path)
+    {
+        if (leaf->prev != nullptr)
+            leaf->prev->next = leaf->next;
+        else
+            head_ = leaf->next;
+        if (leaf->next != nullptr)
+            leaf->next->prev = leaf->prev;
+
+        delete leaf;
+
+        //remove the child from its parent, and the parents that become empty
+        for (int depth = height_ - 1; depth >= 0; --depth)
+        {
+            Inner* inner = path[depth].node;
+            size_t child = path[depth].child;
+
+            if (inner->count > 0)
+            {
+                size_t keyPos = child > 0 ? child - 1 : 0;
+                for (size_t i = keyPos; i + 1 < inner->count; ++i)
+                    inner->keys[i] = inner->keys[i + 1];
+                for (size_t i = child; i < inner->count; ++i)
+                    inner->children[i] = inner->children[i + 1];
+                --inner->count;
+                inner->keys[inner->count] = KEY_PAD;
+                break;
+            }
+
+            //the inner node had a single child: it goes away too
+            if (depth == 0)
+            {
+                //the whole tree is empty: back to a single empty leaf
+                delete inner;
+                root_ = head_ = new Leaf();
+                height_ = 0;
+                return;
+            }
+
+            delete inner;
+        }
+
+        //shrink the root while it has a single child
+        while (height_ > 0 && static_cast<Inner*>(root_)->count == 0)
+        {
+            Inner* inner = static_cast<Inner*>(root_);
+            root_ = inner->children[0];
+            delete inner;
+            --height_;
+        }
+    }
+
+    static void refresh(const Leaf* leaf)
+    {
+        leaf->sumSize = 0;
+        leaf->sumKeySize = 0;
+        for (size_t i = 0; i < leaf->count; ++i)
+        {
+            leaf->sumSize += leaf->values[i].size;
+            leaf->sumKeySize += leaf->values[i].size * leaf->keys[i];
+        }
+        leaf->dirty = false;
+    }
+
+    static void destroy(void* node, const int height)
+    {
+        if (height == 0)
+        {
+            delete static_cast<Leaf*>(node);
+            return;
+        }
+
+        Inner* inner = static_cast<Inner*>(node);
+        for (size_t i = 0; i <= inner->count; ++i)
+            destroy(inner->children[i], height - 1);
+        delete inner;
+    }
+
+    void* root_;
+    int height_;
+    Leaf* head_;
+    size_t size_;
+};
+
+template <size_t LeafCapacity, size_t InnerCapacity>
+FillResult fillLevels(const BPlusTree<LeafCapacity, InnerCapacity>& tree, const long target)
+{
+    return tree.fill(target);
+}
+
+template <size_t LeafCapacity, size_t InnerCapacity>
+NotionalFill fillNotional(const BPlusTree<LeafCapacity, InnerCapacity>& tree, const long long notional)
+{
+    return tree.fillNotional(notional);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+
+#include "book_levels.h"
+#include "price_ladder.h"
+#include "bplus_tree.h"
+#include "flat_levels.h"
+#include "order_index.h"
+
+/*
+Engine selection at startup: the level container and the order id index are named on the command line,
+selectEngine() turns the two names into an Engine tag type and calls a generic lambda with it once,
+the lambda then instantiates BookAnalyzer<typename E::Levels, Params, typename E::Index> (see main.cpp).
+The whole replay loop is compiled for every combination, so the choice costs one branch at startup and nothing
+per event: no virtual call, the containers and the index are inlined into the engine as with a compile time choice.
+
+books:   map     std::map (MapLevels)
+         ladder  price ladder following the touch, std::map beyond its window
+         btree   B+tree
+         flat    sorted parallel arrays
+         hybrid  price ladder following the touch, B+tree beyond its window
+indexes: std     std::unordered_map
+         flat    open addressing hash table
+         direct  ids read as numbers index a vector, the flat hash table for the others (see order_index.h)
+*/
+
+template <class L, class I>
+struct Engine
+{
+    typedef L Levels;
+    typedef I Index;
+};
+
+typedef PriceLadder<1024, BPlusTree<>> HybridLevels;
+
+template <class Levels, class F>
+bool selectIndex(const std::string& index, F&& f)
+{
+    if (index == "std")
+        f(Engine<Levels, StdOrderIndex>());
+    else if (index == "flat")
+        f(Engine<Levels, FlatOrderIndex>());
+    else if (index == "direct")
+        f(Engine<Levels, DirectOrderIndex>());
+    else
+        return false;
+    return true;
+}
+
+//calls f(Engine<Levels, Index>()) for the named book and index, false (and f is not called) for an unknown name
+template <class F>
+bool selectEngine(const std::string& book, const std::string& index, F&& f)
+{
+    if (book == "map")
+        return selectIndex<MapLevels>(index, f);
+    else if (book == "ladder")
+        return selectIndex<PriceLadder<>>(index, f);
+    else if (book == "btree")
+        return selectIndex<BPlusTree<>>(index, f);
+    else if (book == "flat")
+        return selectIndex<FlatLevels>(index, f);
+    else if (book == "hybrid")
+        return selectIndex<HybridLevels>(index, f);
+    return false;
+}
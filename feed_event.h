@@ -0,0 +1,99 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+
+#include "book_levels.h"
+#include "metrics.h"
+
+/*
+One event of the text feed format and how it is applied to a book:
+<timestamp> A <order-id> <side> <price> <size>    add
+<timestamp> R <order-id> <size>                   reduce
+<timestamp> M <order-id> <price> <size>           modify (BookAnalyzer::modifyOrder)
+<timestamp> L <side> <price> <size>               market-by-price level update (BookAnalyzer::setLevel)
+any of them optionally followed by a venue tag (a number, 0 when missing) for consolidated books.
+*/
+
+struct FeedEvent
+{
+    long timestamp;
+    char type;
+    std::string id;
+    Side side;
+    double price;
+    int size;
+    int venue = 0;
+};
+
+//parse one line, false at the end of the feed (a line without timestamp and type)
+inline bool parseFeedEvent(const std::string& line, FeedEvent& event)
+{
+    std::istringstream iss(line);
+    if (!(iss >> event.timestamp >> event.type))
+        return false;
+
+    char side;
+    if (event.type == 'A')
+    {
+        iss >> event.id >> side >> event.price >> event.size;
+        event.side = side == 'B' ? Side::BUY : Side::SELL;
+    }
+    else if (event.type == 'L')
+    {
+        event.id.clear(); //levels have no order id, the event may be reused from an order line
+        iss >> side >> event.price >> event.size;
+        event.side = side == 'B' ? Side::BUY : Side::SELL;
+    }
+    else if (event.type == 'M')
+    {
+        iss >> event.id >> event.price >> event.size;
+    }
+    else if (event.type == 'R')
+    {
+        iss >> event.id >> event.size;
+    }
+
+    if (!(iss >> event.venue))
+        event.venue = 0;
+    return true;
+}
+
+//order ids are only unique within a venue: in a consolidated book the venue tag becomes part of the id of A, R and M events
+inline void qualifyVenueId(FeedEvent& event)
+{
+    if (event.type != 'L' && !event.id.empty())
+    {
+        event.id += '@';
+        event.id += std::to_string(event.venue);
+    }
+}
+
+template <class Analyzer>
+void applyFeedEvent(Analyzer& bookAnalyzer, const FeedEvent& event)
+{
+    if (event.type == 'A') //if new order process it
+    {
+        Metrics::count(Metric::ADDS);
+        bookAnalyzer.handleNewOrder(event.id, event.side, event.size, event.price, event.timestamp, static_cast<uint8_t>(event.venue));
+    }
+    else if (event.type == 'L') //market-by-price: new total size of a level
+    {
+        Metrics::count(Metric::LEVEL_UPDATES);
+        bookAnalyzer.setLevel(event.side, event.size, event.price, event.timestamp, static_cast<uint8_t>(event.venue));
+    }
+    else if (event.type == 'M') //modify existing order: new price and size
+    {
+        Metrics::count(Metric::MODIFIES);
+        bookAnalyzer.modifyOrder(event.id, event.size, event.price, event.timestamp);
+    }
+    else if (event.type == 'R') //else reduce existing order
+    {
+        Metrics::count(Metric::REDUCES);
+        const OrderInfo* order = bookAnalyzer.findOrder(event.id);
+        if (order != nullptr)
+            bookAnalyzer.reduceOrder(event.id, order->side, event.size, event.timestamp);
+        else
+            Metrics::count(Metric::UNKNOWN_REDUCES); //ignore, order id not found
+    }
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "feed_event.h"
+#include "metrics.h"
+#include "trace.h"
+
+/*
+Time ordered merge of several text feeds of the same instrument (one file per channel or session).
+
+Every file is read and parsed by its own thread (FeedReader), which hands the parsed events over in batches
+through a small bounded queue, so the merging thread only touches a lock once per batch.
+The merging thread keeps the current event of each feed in a tournament (loser) tree: the winner is the earliest event,
+ties on the timestamp go to the feed given first, and the events of one feed keep their order.
+Taking the winner and refilling its leaf replays one path of the tree, O(log N) comparisons for N feeds.
+
+Each feed must be in time order on its own; FeedMerge does not reorder events inside a feed.
+For a consolidated book (one feed per venue) the events can be tagged with the index of their feed as venue.
+*/
+
+class FeedReader
+{
+public:
+
+    static const size_t BATCH_SIZE = 4096;
+    static const size_t MAX_BATCHES = 4;
+
+    //venue >= 0 tags every event of the feed with that venue
+    explicit FeedReader(const std::string& file, const int venue = -1) : infile_(file), venue_(venue), done_(false)
+    {
+        if (infile_)
+            thread_ = std::thread(&FeedReader::read, this);
+        else
+            done_ = true;
+    }
+
+    ~FeedReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+            batches_.clear();
+        }
+        changed_.notify_all();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    FeedReader(const FeedReader&) = delete;
+    FeedReader& operator=(const FeedReader&) = delete;
+
+    bool good() const { return thread_.joinable(); }
+
+    //next batch of events, an empty batch at the end of the feed
+    std::vector<FeedEvent> next()
+    {
+        TRACE_SCOPE("wait batch");
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return !batches_.empty() || done_; });
+        if (batches_.empty())
+            return std::vector<FeedEvent>();
+
+        std::vector<FeedEvent> batch = std::move(batches_.front());
+        batches_.pop_front();
+        lock.unlock();
+        changed_.notify_all();
+        return batch;
+    }
+
+private:
+
+    void read()
+    {
+        TRACE_THREAD_NAME("feed reader");
+        std::vector<FeedEvent> batch;
+        batch.reserve(BATCH_SIZE);
+
+        bool more;
+        do
+        {
+            more = parse(batch);
+            if (!batch.empty() && !push(batch))
+                return;
+        } while (more);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+        changed_.notify_all();
+    }
+
+    //parse the next events of the feed into batch until it is full, false at the end of the feed
+    bool parse(std::vector<FeedEvent>& batch)
+    {
+        TRACE_SCOPE("parse batch");
+        std::string line;
+        FeedEvent event;
+        while (batch.size() < BATCH_SIZE)
+        {
+            if (!std::getline(infile_, line))
+                return false;
+            Metrics::count(Metric::BYTES_READ, line.size() + 1);
+            if (!parseFeedEvent(line, event))
+                return false;
+            if (venue_ >= 0)
+                event.venue = venue_;
+            batch.push_back(event);
+        }
+        return true;
+    }
+
+    //false when the reader is being destroyed
+    bool push(std::vector<FeedEvent>& batch)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return batches_.size() < MAX_BATCHES || done_; });
+        if (done_)
+            return false;
+
+        batches_.push_back(std::move(batch));
+        lock.unlock();
+        changed_.notify_all();
+
+        batch = std::vector<FeedEvent>();
+        batch.reserve(BATCH_SIZE);
+        return true;
+    }
+
+    std::ifstream infile_;
+    int venue_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::vector<FeedEvent>> batches_;
+    bool done_;
+    std::thread thread_;
+};
+
+class FeedMerge
+{
+public:
+
+    //with venuePerFile the events of the i-th file are tagged with venue i
+    explicit FeedMerge(const std::vector<std::string>& files, const bool venuePerFile = false)
+    {
+        for (size_t i = 0; i < files.size(); ++i)
+            sources_.emplace_back(new Source(files[i], venuePerFile ? static_cast<int>(i) : -1));
+    }
+
+    //the feeds that could not be opened, empty if all of them were
+    std::vector<std::string> failed(const std::vector<std::string>& files) const
+    {
+        std::vector<std::string> result;
+        for (size_t i = 0; i < sources_.size(); ++i)
+        {
+            if (!sources_[i]->reader.good())
+                result.push_back(files[i]);
+        }
+        return result;
+    }
+
+    //call f(event) for every event of every feed in time order, returns the number of events
+    template <class F>
+    long run(F&& f)
+    {
+        const size_t n = sources_.size();
+        if (n == 0)
+            return 0;
+
+        for (size_t i = 0; i < n; ++i)
+            refill(i);
+        build();
+
+        long events = 0;
+        while (current(losers_[0]) != nullptr)
+        {
+            TRACE_SCOPE("apply batch");
+            for (size_t i = 0; i < FeedReader::BATCH_SIZE && current(losers_[0]) != nullptr; ++i)
+            {
+                size_t winner = losers_[0];
+                Source& source = *sources_[winner];
+                f(source.batch[source.pos]); //the batch is ours, f may modify the event
+                ++events;
+
+                if (++source.pos == source.batch.size())
+                    refill(winner);
+
+                //replay the path from the winner's leaf to the root
+                for (size_t node = (winner + n) / 2; node > 0; node /= 2)
+                {
+                    if (before(losers_[node], winner))
+                        std::swap(losers_[node], winner);
+                }
+                losers_[0] = winner;
+            }
+        }
+
+        return events;
+    }
+
+private:
+
+    struct Source
+    {
+        Source(const std::string& file, const int venue) : reader(file, venue), pos(0)
+        {   }
+
+        FeedReader reader;
+        std::vector<FeedEvent> batch;
+        size_t pos;
+    };
+
+    void refill(const size_t i)
+    {
+        Source& source = *sources_[i];
+        source.batch = source.reader.next();
+        source.pos = 0;
+    }
+
+    const FeedEvent* current(const size_t i) const
+    {
+        const Source& source = *sources_[i];
+        return source.pos < source.batch.size() ? &source.batch[source.pos] : nullptr;
+    }
+
+    //the current event of feed a goes before the one of feed b: earlier, or same time and a given first; ended feeds go last
+    bool before(const size_t a, const size_t b) const
+    {
+        const FeedEvent* x = current(a);
+        const FeedEvent* y = current(b);
+        if (x == nullptr || y == nullptr)
+            return y == nullptr && (x != nullptr || a < b);
+        return x->timestamp < y->timestamp || (x->timestamp == y->timestamp && a < b);
+    }
+
+    //leaves are the nodes n..2n-1, internal nodes 1..n-1 keep the loser of their match, node 0 the overall winner
+    void build()
+    {
+        const size_t n = sources_.size();
+        std::vector<size_t> winners(2 * n);
+        losers_.assign(n, 0);
+
+        for (size_t i = 0; i < n; ++i)
+            winners[n + i] = i;
+        for (size_t node = n - 1; node > 0; --node)
+        {
+            size_t left = winners[2 * node];
+            size_t right = winners[2 * node + 1];
+            bool leftWins = before(left, right);
+            winners[node] = leftWins ? left : right;
+            losers_[node] = leftWins ? right : left;
+        }
+        losers_[0] = n > 1 ? winners[1] : 0;
+    }
+
+    std::vector<std::unique_ptr<Source>> sources_;
+    std::vector<size_t> losers_;
+};
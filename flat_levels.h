@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "book_levels.h"
+
+/*
+Level container storing the levels as parallel sorted arrays (struct of arrays):
+keys_   the level keys,
+sizes_  the aggregated size of each level,
+slots_  where the level itself (size, order count and queue, the first order is the front of the queue) sits in pool_.
+
+The arrays are sorted worst-first, so the best level is the last element: the changes near the touch,
+by far the most frequent, insert and erase at the end of the arrays and shift only the few levels behind them
+(20 bytes per level, the levels themselves stay in their pool slot). A look-up is a binary search over keys_.
+pool_ is a std::vector: growing it moves every level, so the Level returned by find/insert is only valid until the next
+insert (as for the other containers, the engine never keeps one across an insert; erase only clears a slot).
+Inserting or erasing far from the touch shifts the whole tail of the arrays: this container is meant for books that are
+compact around the touch, wide books are better served by the price ladder or the B+tree.
+
+The target walks read only keys_ and sizes_, backwards from the best level and sequentially in memory,
+in blocks of BLOCK levels whose sums are plain loops the compiler vectorizes: a block is taken whole while it fits
+in what is left of the target, only the last block is walked level by level.
+
+The engine updates level sizes in place (find/insert return the level), so sizes_ is refreshed lazily:
+find/insert remember the index they returned, and the sizes at the positions remembered are copied from the pool before
+anything that moves the arrays or reads sizes_.
+*/
+
+class FlatLevels
+{
+public:
+
+    static const size_t BLOCK = 8;
+
+    Level* find(const Tick key)
+    {
+        size_t index = lowerBound(key);
+        if (index == keys_.size() || keys_[index] != key)
+            return nullptr;
+
+        markDirty(index);
+        return &pool_[slots_[index]];
+    }
+
+    //return the level for key, creating an empty one if it doesn't exist
+    Level& insert(const Tick key)
+    {
+        size_t index = lowerBound(key);
+        if (index == keys_.size() || keys_[index] != key)
+        {
+            sync();
+            keys_.insert(keys_.begin() + index, key);
+            sizes_.insert(sizes_.begin() + index, 0);
+            slots_.insert(slots_.begin() + index, allocate());
+        }
+
+        markDirty(index);
+        return pool_[slots_[index]];
+    }
+
+    void insert(const Tick key, Level&& level)
+    {
+        insert(key) = std::move(level);
+    }
+
+    void erase(const Tick key)
+    {
+        size_t index = lowerBound(key);
+        if (index == keys_.size() || keys_[index] != key)
+            return;
+
+        sync();
+        release(slots_[index]);
+        keys_.erase(keys_.begin() + index);
+        sizes_.erase(sizes_.begin() + index);
+        slots_.erase(slots_.begin() + index);
+    }
+
+    bool empty() const { return keys_.empty(); }
+    size_t size() const { return keys_.size(); }
+
+    Tick bestKey() const { return keys_.back(); }
+
+    //remove the best level and hand it over to the caller
+    Level popBest()
+    {
+        sync();
+        Level level = std::move(pool_[slots_.back()]);
+        release(slots_.back());
+        keys_.pop_back();
+        sizes_.pop_back();
+        slots_.pop_back();
+        return level;
+    }
+
+    //visit levels best-first until f(key, level) returns false
+    template <class F>
+    void forEach(F&& f) const
+    {
+        for (size_t i = keys_.size(); i > 0; --i)
+        {
+            if (!f(keys_[i - 1], static_cast<const Level&>(pool_[slots_[i - 1]])))
+                return;
+        }
+    }
+
+    //take levels best-first until target shares are filled, whole blocks at once when they fit
+    FillResult fill(const long target) const
+    {
+        sync();
+        FillResult result;
+
+        size_t end = keys_.size();
+        while (end >= BLOCK)
+        {
+            long size = 0;
+            long long keySize = 0;
+            for (size_t i = end - BLOCK; i < end; ++i)
+            {
+                size += sizes_[i];
+                keySize += sizes_[i] * keys_[i];
+            }
+
+            if (size > target - result.filled)
+                break;
+
+            result.filled += size;
+            result.keyAmount += keySize;
+            result.lastKey = keys_[end - BLOCK];
+            result.levels += BLOCK;
+            end -= BLOCK;
+            if (result.filled == target)
+                return result;
+        }
+
+        for (; end > 0 && result.filled < target; --end)
+        {
+            long localSize = std::min(sizes_[end - 1], target - result.filled);
+            result.keyAmount += localSize * keys_[end - 1];
+            result.filled += localSize;
+            result.lastKey = keys_[end - 1];
+            ++result.levels;
+        }
+
+        return result;
+    }
+
+    //take levels best-first until the notional is spent, whole blocks at once when their amount is below what is left
+    NotionalFill fillNotional(const long long notional) const
+    {
+        sync();
+        NotionalFill result;
+        result.remaining = notional;
+
+        size_t end = keys_.size();
+        while (end >= BLOCK)
+        {
+            long size = 0;
+            long long keySize = 0;
+            for (size_t i = end - BLOCK; i < end; ++i)
+            {
+                size += sizes_[i];
+                keySize += sizes_[i] * keys_[i];
+            }
+
+            long long amount = keySize < 0 ? -keySize : keySize; //the keys of a side share their sign
+            if (amount >= result.remaining)
+                break;
+
+            result.filled += size;
+            result.keyAmount += keySize;
+            result.remaining -= amount;
+            result.lastKey = keys_[end - BLOCK];
+            result.levels += BLOCK;
+            end -= BLOCK;
+        }
+
+        for (; end > 0; --end)
+        {
+            if (!result.take(keys_[end - 1], sizes_[end - 1]))
+                break;
+        }
+
+        return result;
+    }
+
+private:
+
+    static const size_t MAX_DIRTY = 16;
+
+    //index of the first key not greater than key (keys_ is sorted descending)
+    size_t lowerBound(const Tick key) const
+    {
+        return static_cast<size_t>(std::lower_bound(keys_.begin(), keys_.end(), key, std::greater<Tick>()) - keys_.begin());
+    }
+
+    uint32_t allocate()
+    {
+        if (free_.empty())
+        {
+            pool_.emplace_back();
+            return static_cast<uint32_t>(pool_.size() - 1);
+        }
+
+        uint32_t slot = free_.back();
+        free_.pop_back();
+        return slot;
+    }
+
+    void release(const uint32_t slot)
+    {
+        pool_[slot] = Level();
+        free_.push_back(slot);
+    }
+
+    void markDirty(const size_t index)
+    {
+        if (dirty_.size() == MAX_DIRTY)
+            sync();
+        dirty_.push_back(index);
+    }
+
+    //copy the sizes of the levels handed out since the last sync into sizes_
+    void sync() const
+    {
+        for (size_t index : dirty_)
+            sizes_[index] = pool_[slots_[index]].size;
+        dirty_.clear();
+    }
+
+    std::vector<Tick> keys_;
+    mutable std::vector<long> sizes_;
+    std::vector<uint32_t> slots_;
+    mutable std::vector<size_t> dirty_;
+    std::vector<Level> pool_;
+    std::vector<uint32_t> free_;
+};
+
+inline FillResult fillLevels(const FlatLevels& levels, const long target)
+{
+    return levels.fill(target);
+}
+
+inline NotionalFill fillNotional(const FlatLevels& levels, const long long notional)
+{
+    return levels.fillNotional(notional);
+}
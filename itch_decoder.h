@@ -0,0 +1,255 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "book_levels.h"
+#include "metrics.h"
+#include "trace.h"
+
+/*
+NASDAQ TotalView-ITCH 5.0 decoder feeding a book directly, without going through the A/R text format.
+
+Messages handled (fields are big-endian, offsets as in the ITCH 5.0 specification):
+A add order, F add order with MPID attribution  -> handleNewOrder
+E order executed, C order executed with price,
+X order cancel                                  -> reduceOrder by the executed/cancelled shares
+D order delete                                  -> reduceOrder by the whole remaining size
+U order replace                                 -> replaceOrder (new reference number, size and price, priority lost)
+every other message type is counted and skipped.
+
+The 8 byte order reference number becomes the order id as its decimal string, written into a reused std::string:
+ids up to 15 digits fit in the small string buffer, so decoding a message does not allocate.
+Prices have 4 decimals: the book has to run with a tick scale of ITCH_TICK_SCALE, so that every price is a whole
+number of its ticks (with the default scale of the text feed, cents, sub-penny prices would be rounded).
+Timestamps are nanoseconds since midnight and are passed through.
+
+Capture files are a sequence of messages, each preceded by its 2 byte big-endian length (as in the NASDAQ daily files).
+With a symbol only the adds of that stock enter the book; the other messages refer to orders by reference number,
+unique for the day, so those of other stocks are ignored as unknown ids.
+*/
+
+//Price(4) fields: the tick scale of a book fed by the decoder
+const long ITCH_TICK_SCALE = 10000;
+
+struct ItchStats
+{
+    long messages = 0;
+    long adds = 0;
+    long executions = 0;
+    long cancels = 0;
+    long deletes = 0;
+    long replaces = 0;
+    long skipped = 0;    //other message types, and adds of other symbols
+    long truncated = 0;
+};
+
+template <class Book>
+class ItchDecoder
+{
+public:
+
+    ItchDecoder(Book& book, const std::string& symbol = std::string()) : book_(book), filter_(!symbol.empty())
+    {
+        std::memset(symbol_, ' ', sizeof(symbol_));
+        std::memcpy(symbol_, symbol.data(), std::min(symbol.size(), sizeof(symbol_)));
+    }
+
+    const ItchStats& stats() const { return stats_; }
+
+    //decode one message (without its length prefix)
+    void decode(const uint8_t* msg, const size_t length)
+    {
+        ++stats_.messages;
+        if (length < HEADER_LENGTH || length < messageLength(msg[0]))
+        {
+            ++stats_.truncated;
+            return;
+        }
+
+        long timestamp = static_cast<long>(readBE48(msg + 5));
+
+        switch (msg[0])
+        {
+        case 'A':
+        case 'F':
+        {
+            if (filter_ && std::memcmp(msg + 24, symbol_, sizeof(symbol_)) != 0)
+            {
+                ++stats_.skipped;
+                return;
+            }
+
+            Side side = msg[19] == 'B' ? Side::BUY : msg[19] == 'S' ? Side::SELL : Side::UNKNOWN;
+            setId(id_, readBE64(msg + 11));
+            book_.handleNewOrder(id_, side, static_cast<int>(readBE32(msg + 20)), price(msg + 32), timestamp);
+            ++stats_.adds;
+            Metrics::count(Metric::ADDS);
+            break;
+        }
+        case 'E':
+        case 'C':
+            reduce(msg + 11, static_cast<int>(readBE32(msg + 19)), timestamp);
+            ++stats_.executions;
+            break;
+        case 'X':
+            reduce(msg + 11, static_cast<int>(readBE32(msg + 19)), timestamp);
+            ++stats_.cancels;
+            break;
+        case 'D':
+            reduce(msg + 11, INT_MAX, timestamp);
+            ++stats_.deletes;
+            break;
+        case 'U':
+            setId(id_, readBE64(msg + 11));
+            setId(newId_, readBE64(msg + 19));
+            book_.replaceOrder(id_, newId_, static_cast<int>(readBE32(msg + 27)), price(msg + 31), timestamp);
+            ++stats_.replaces;
+            Metrics::count(Metric::REPLACES);
+            break;
+        default:
+            ++stats_.skipped;
+            break;
+        }
+    }
+
+    //decode a buffer of length prefixed messages, returns the bytes consumed (a partial message at the end is left over);
+    //poll() is called after every message
+    template <class Poll>
+    size_t decodeStream(const uint8_t* data, const size_t size, Poll&& poll)
+    {
+        size_t pos = 0;
+        while (pos + 2 <= size)
+        {
+            size_t length = readBE16(data + pos);
+            if (pos + 2 + length > size)
+                break;
+
+            decode(data + pos + 2, length);
+            pos += 2 + length;
+            poll();
+        }
+        return pos;
+    }
+
+    size_t decodeStream(const uint8_t* data, const size_t size)
+    {
+        return decodeStream(data, size, [] {});
+    }
+
+    //decode a whole capture file, false if it cannot be read
+    bool decodeFile(const std::string& file)
+    {
+        return decodeFile(file, [] {});
+    }
+
+    template <class Poll>
+    bool decodeFile(const std::string& file, Poll&& poll)
+    {
+        std::ifstream infile(file, std::ios::binary);
+        if (!infile)
+            return false;
+
+        std::vector<uint8_t> data;
+        {
+            TRACE_SCOPE("read capture");
+            data.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+        }
+        Metrics::count(Metric::BYTES_READ, data.size());
+
+        TRACE_SCOPE("decode capture");
+        if (decodeStream(data.data(), data.size(), poll) != data.size())
+            ++stats_.truncated;
+        return true;
+    }
+
+    static uint16_t readBE16(const uint8_t* p)
+    {
+        return static_cast<uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    static uint32_t readBE32(const uint8_t* p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return __builtin_bswap32(value);
+    }
+
+    static uint64_t readBE48(const uint8_t* p)
+    {
+        return uint64_t(readBE16(p)) << 32 | readBE32(p + 2);
+    }
+
+    static uint64_t readBE64(const uint8_t* p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return __builtin_bswap64(value);
+    }
+
+private:
+
+    //type (1), stock locate (2), tracking number (2), timestamp (6)
+    static const size_t HEADER_LENGTH = 11;
+
+    //minimal length of the handled messages, 0 for the others
+    static size_t messageLength(const uint8_t type)
+    {
+        switch (type)
+        {
+        case 'A': return 36;
+        case 'F': return 40;
+        case 'E': return 31;
+        case 'C': return 36;
+        case 'X': return 23;
+        case 'D': return 19;
+        case 'U': return 35;
+        default: return 0;
+        }
+    }
+
+    static double price(const uint8_t* p)
+    {
+        return readBE32(p) / static_cast<double>(ITCH_TICK_SCALE);
+    }
+
+    static void setId(std::string& id, uint64_t reference)
+    {
+        char digits[20];
+        int n = 0;
+        do
+        {
+            digits[n++] = static_cast<char>('0' + reference % 10);
+            reference /= 10;
+        } while (reference > 0);
+
+        id.resize(static_cast<size_t>(n));
+        for (size_t i = 0; n > 0; ++i)
+            id[i] = digits[--n];
+    }
+
+    void reduce(const uint8_t* reference, const int size, const long timestamp)
+    {
+        setId(id_, readBE64(reference));
+        Metrics::count(Metric::REDUCES);
+        const OrderInfo* order = book_.findOrder(id_);
+        if (order != nullptr)
+            book_.reduceOrder(id_, order->side, size, timestamp);
+        else
+            Metrics::count(Metric::UNKNOWN_REDUCES);
+    }
+
+    Book& book_;
+    bool filter_;
+    char symbol_[8];
+    std::string id_;
+    std::string newId_;
+    ItchStats stats_;
+};
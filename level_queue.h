@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Time priority queue of the orders resting at one price level.
+
+Orders are appended in arrival order, each order remembers its slot (seq) in the queue.
+Next to the slots the queue keeps a Fenwick tree over the remaining size of each slot, so that
+the size ahead of an order (sum of the slots before its seq) is O(log n), and so are size updates.
+
+Removed orders leave an empty slot behind (nullptr, size 0). When the empty slots outnumber the live ones
+the queue is compacted: live orders are renumbered in order and the tree is rebuilt in O(n), amortized O(1) per removal.
+
+Order is any record with an int size and a uint32_t seq; the queue only holds pointers to it,
+so the records must not move while they are queued.
+*/
+
+class FenwickTree
+{
+public:
+
+    size_t size() const { return tree_.size() - 1; }
+
+    void clear()
+    {
+        tree_.assign(1, 0);
+    }
+
+    //append a value at index size(), O(log n)
+    void append(const long long value)
+    {
+        size_t index = tree_.size(); //1-based index of the new element
+        size_t lowBit = index & (~index + 1);
+        tree_.push_back(value + prefix(index - 1) - prefix(index - lowBit));
+    }
+
+    void add(size_t index, const long long delta)
+    {
+        for (++index; index < tree_.size(); index += index & (~index + 1))
+            tree_[index] += delta;
+    }
+
+    //sum of the values at indexes [0, count)
+    long long prefix(size_t count) const
+    {
+        long long sum = 0;
+        for (; count > 0; count -= count & (~count + 1))
+            sum += tree_[count];
+        return sum;
+    }
+
+    //rebuild from plain values, O(n)
+    void build(const std::vector<long long>& values)
+    {
+        tree_.assign(values.size() + 1, 0);
+        for (size_t i = 1; i < tree_.size(); ++i)
+        {
+            tree_[i] += values[i - 1];
+            size_t parent = i + (i & (~i + 1));
+            if (parent < tree_.size())
+                tree_[parent] += tree_[i];
+        }
+    }
+
+private:
+
+    std::vector<long long> tree_ = std::vector<long long>(1, 0);
+};
+
+template <class Order>
+class LevelQueue
+{
+public:
+
+    LevelQueue() : count_(0), head_(0)
+    {   }
+
+    size_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    void clear()
+    {
+        orders_.clear();
+        sizes_.clear();
+        count_ = 0;
+        head_ = 0;
+    }
+
+    void push(Order* order)
+    {
+        order->seq = static_cast<uint32_t>(orders_.size());
+        orders_.push_back(order);
+        sizes_.append(order->size);
+        ++count_;
+    }
+
+    //the order size went down by reduced, the order keeps its priority
+    void reduce(const Order* order, const int reduced)
+    {
+        sizes_.add(order->seq, -reduced);
+    }
+
+    void remove(const Order* order)
+    {
+        sizes_.add(order->seq, -order->size);
+        orders_[order->seq] = nullptr;
+        --count_;
+
+        while (head_ < orders_.size() && orders_[head_] == nullptr)
+            ++head_;
+
+        if (orders_.size() > 2 * count_ + 16)
+            compact();
+    }
+
+    //size resting ahead of order in this level, O(log n)
+    long long ahead(const Order* order) const
+    {
+        return sizes_.prefix(order->seq);
+    }
+
+    Order* front() const
+    {
+        return count_ > 0 ? orders_[head_] : nullptr;
+    }
+
+    //visit the orders in time priority until f(order) returns false
+    template <class F>
+    void forEach(F&& f) const
+    {
+        for (size_t i = head_; i < orders_.size(); ++i)
+        {
+            if (orders_[i] != nullptr && !f(orders_[i]))
+                return;
+        }
+    }
+
+private:
+
+    void compact()
+    {
+        std::vector<long long> sizes;
+        sizes.reserve(count_);
+
+        size_t live = 0;
+        for (size_t i = head_; i < orders_.size(); ++i)
+        {
+            if (orders_[i] == nullptr)
+                continue;
+
+            orders_[live] = orders_[i];
+            orders_[live]->seq = static_cast<uint32_t>(live);
+            sizes.push_back(orders_[live]->size);
+            ++live;
+        }
+
+        orders_.resize(live);
+        sizes_.build(sizes);
+        head_ = 0;
+    }
+
+    std::vector<Order*> orders_;
+    FenwickTree sizes_;
+    size_t count_;
+    size_t head_;
+};
@@ -1,343 +1,563 @@
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <string>
-#include <map>
-#include <unordered_map>
-#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "book_analyzer.h"
+#include "feed_event.h"
+#include "engine_factory.h"
+#include "feed_merge.h"
+#include "itch_decoder.h"
+#include "metrics.h"
+#include "parallel_replay.h"
+#include "pcap_reader.h"
+#include "portfolio.h"
+#include "trace.h"
 
 /*
-This implementation keeps 3 separate data structures of 2 different types. 
+The book engine lives in book_analyzer.h, the level containers in book_levels.h, price_ladder.h, bplus_tree.h and flat_levels.h,
+the order id indexes in order_index.h; engine_factory.h picks the container and the index named on the command line.
+reference_book.h keeps the engine of the first version and a direct, slow implementation of the current semantics;
+tools/differential.cpp checks the engine against both.
 
-1)
-map <price : un_map <id : size> >
-Each map key is the price. Each map value is an unordered map (hash table) where the key is the id of the order and the value is the size.
-
-We have one map for the Buy orders, that will keep the items ordered by price in descending order;
-one map for the Sell orders, that will keep the items ordered by price in ascending order;
-
-This way iterating through the maps we will find always the highest/lowest prices that will be used for expenses/income computation.
-
-2) 
-map <id : <side, price> >
-The second data structure is an unordered_map where the key is the order id and the value is a pair (side of order, price)
-This map will keep orders in memory as long as there is a corresponding size on mkt for a given order id.
-
-We can look up the order by id in the hash table (constant time access), and given the price of that order we can go into the Buy or Sell Maps 
-and look for the price in that map (time complexity O(logn)).
-
-When an order needs to be reduced, we look up the id in the hash table, then find the corresponding price in the appropriate map, and finally we reduce the size.
-If the size becomes 0, then we remove the information about that order id from both data structures.
-
-The input of this program is a file, and the file name is specified in the main itself, as well as the target.
+The input of this program is a file, by default book_analyzer.in with a target of 200 shares.
 The output of this program is simply printed to stdout.
 
-
-This implementation focuses on speed rather than space. Space complextity will be O(n) 
-since we have to store in memory all orders as long as there is a size>0 on market. 
-The bigger the target the bigger the memory space we will use.
-
-On the other end, the time complexity to remove order is reduced to:
-O(1) (hash table id look-up) + 
-O(log(n)) (buy/sell maps price look-up) + 
-O(1) (most cases, worst case O(m) when we need to iterate through all orders (m) with same price)
-
-
-Time complexity to add new order:
-O(log(n)) to insert new item in buy/sell maps +
-O(1) insert element in hash table +
-O(1) time to compute new income/expenses (worst case O(n*m) (potentially you need to go through all itemns in the buy/sell map))
-
-
-Downside of this solution is that it maintains 2 parallel maps (buy and sell) 
-which causes parallel code because the maps have different comparators and are not of the same 'type'
+Besides A (add) and R (reduce) the input may carry modify events:
+  <timestamp> M <order-id> <price> <size>
+setting the remaining size and the price of a resting order (see BookAnalyzer::modifyOrder).
+Venues publishing market-by-price data are fed as level updates instead of orders:
+  <timestamp> L <side> <price> <total size at that price, 0 removes the level>
+the output is the same as for the equivalent order feed (tools/mbp_convert.cpp converts one into the other).
+
+Usage: book_analyzer [--target N | --notional X] [--tick-scale S] [--book B] [--index I] [--itch | --pcap [--port P] [--pace X]]
+                     [--symbol S] [--consolidated] [--match] [--top] [--approximate T] [--band T] [--parallel K] [--stats]
+                     [--trace file [--trace-sample N]] [--metrics-file file] [--metrics-every S] [file...]
+       book_analyzer --portfolio positions [--tick-scale S] [--book B] [--index I] [--trace file [--trace-sample N]]
+                     [--metrics-file file] [--metrics-every S]
+  --target N   number of shares to buy/sell (default 200)
+  --notional X the target is an amount of money instead: every line reports the whole shares that X buys/sells
+               and their average price, <timestamp> <side> <shares> <average price>
+  --tick-scale S
+               ticks per unit of price (default 100 for text feeds, 10000 for --itch and --pcap): prices are rounded
+               to the nearest tick, so a feed with more decimals than the ticks needs a larger scale (see book_levels.h);
+               --approximate and --band are given in these ticks
+  --book       level container: map (std::map, default), ladder (price ladder following the touch), btree (B+tree),
+               flat (sorted parallel arrays) or hybrid (price ladder with a B+tree beyond its window)
+  --index      order id index: std (std::unordered_map, default), flat (open addressing hash table)
+               or direct (numeric and sequential letter ids index a vector, see order_index.h)
+               every book and index pair is compiled in, the choice costs nothing per event
+  --itch       the file is an ITCH 5.0 capture (length prefixed binary messages, see itch_decoder.h) instead of text,
+               timestamps are printed in nanoseconds and the book keeps the 4 decimals of the prices (ticks of 0.0001);
+               --symbol keeps only the orders of that stock
+  --pcap       the file is a pcap/pcapng capture of MoldUDP64 ITCH packets (see pcap_reader.h),
+               --port keeps the packets sent to that UDP port, --pace X replays at X times the capture timing
+               (default 0, full speed) and writes the lines of every packet out as soon as it is decoded
+  file...      more than one text feed are read concurrently and merged by timestamp (ties in the order of the files),
+               see feed_merge.h
+  --consolidated
+               one book across venues: each text feed given is a venue (venue tags 0, 1, ... in file order),
+               or a single feed tags its events with a trailing venue number; every amount line is followed by
+               the venue split of the fill, v<venue> <shares> <amount> for each venue it takes shares from
+  --match      match incoming orders that cross the opposite side (price-time priority), printing trade records
+               <timestamp> T <aggressor id> <resting id> <price> <size>
+  --top        append best bid, bid size, best ask, ask size, spread and mid to every output line
+  --approximate T
+               approximate mode for deep targets: levels are aggregated in buckets of T ticks and the walk takes whole buckets,
+               every amount is followed by its error bound (see BookAnalyzer::bucketTicks_)
+  --band T     orders entering more than T ticks behind the best of their side are kept off the levels until the touch
+               comes within T ticks of them (see BookAnalyzer::bandTicks_), the output is unchanged
+  --parallel K replay a single text feed in K segments on K threads, from checkpoints of the book taken by a fast pre-pass,
+               the output is the same (see parallel_replay.h); not with --match, --consolidated, --approximate or --band
+  --stats      print level container statistics to stderr at the end of the run
+  --trace file write a timeline of the run (parse chunks, batch application, target walks, output flushes per thread)
+               as Chrome trace JSON, for chrome://tracing or ui.perfetto.dev; needs a build with -DBOOK_TRACE (see trace.h)
+  --trace-sample N
+               record one target walk in N (default 1), the walks happen once per book change
+  --metrics-file file
+               where the live metrics go (default stderr), rewritten whole at every dump and at the end of the run
+  --metrics-every S
+               dump the metrics every S seconds and at the end of the run; whatever the options, SIGUSR1 dumps them
+               (Prometheus text format: events by type, lines, NA transitions, live orders and levels, see metrics.h)
+  --portfolio  liquidation value of a portfolio (see portfolio.h): every line of the positions file is
+                 <symbol> <position, negative for short> <text feed of the symbol>
+               the feeds are merged by timestamp, and whenever the unwind value of a position changes
+                 <timestamp> <symbol> <value> <portfolio total>
+               is printed (values of short positions are negative, NA when the book cannot take the position)
+
+Build with -pthread (the feed merge reads every file in its own thread).
+Building with -DFIXED_TARGET=N (and optionally -DFIXED_TICK_SCALE=S) adds an engine specialized at compile time
+for that target and tick scale, it is used when --target matches N and the feed has that tick scale.
+Building with -DBOOK_SPLIT_ORDERS keeps the hot and the cold fields of the orders in separate arrays (see order_store.h).
+Building with -DBOOK_TRACE compiles in the tracing behind --trace, without it the trace points are compiled out.
+Where <sys/sdt.h> is available the engine carries static probes for bpftrace/perf (see probes.h and tools/book_probes.bt),
+-DBOOK_NO_PROBES leaves them out.
 */
 
-enum Side {
-    BUY = 0,
-    SELL,
-    UNKNOWN
+struct Options
+{
+    int target = 200;
+    double notional = 0;
+    long tickScale = 0; //0 for the default of the feed format
+    std::string file = "book_analyzer.in";
+    std::vector<std::string> merge; //more than one text feed: merged by timestamp
+    std::string book = "map";
+    std::string index = "std";
+    bool itch = false;
+    bool pcap = false;
+    uint16_t port = 0;
+    double pace = 0;
+    std::string symbol;
+    std::string portfolio;
+    bool match = false;
+    bool consolidated = false;
+    bool top = false;
+    long approximate = 0;
+    long band = 0;
+    size_t parallel = 0;
+    bool stats = false;
+    std::string trace;
+    long traceSample = 1;
+    std::string metricsFile;
+    double metricsEvery = 0;
 };
 
-
-class BookAnalyzer 
+//ITCH prices have 4 decimals, text feed prices are in cents, unless --tick-scale says otherwise
+long feedTickScale(const Options& options)
 {
-    struct comparatorBuy {
-        bool operator()(const double& a, const double& b)
-        {
-            return a > b;
-        }
-    };
-
-    struct comparatorSell {
-        bool operator()(const double& a, const double& b)
-        {
-            return a < b;
-        }
-    };
-
-public:
+    if (options.tickScale > 0)
+        return options.tickScale;
+    return options.itch || options.pcap ? ITCH_TICK_SCALE : TICK_SCALE;
+}
 
-    BookAnalyzer(int target) : target_(target), totBuySize_(0), totSellSize_(0), prevExpenses_(0), prevIncome_(0), prevNanExp_(true), prevNanIncome_(true) 
-    {   }
-
-    int target_;
-    int totBuySize_;
-    int totSellSize_;
-    double prevExpenses_;
-    bool prevNanExp_;
-    double prevIncome_;
-    bool prevNanIncome_;
+template <class Levels>
+void printLevelStats(const Levels& levels, const char* name)
+{
+    std::cerr << name << " levels " << levels.size() << std::endl;
+}
 
-    //keep items ordered by price, so that we can always get the next min/max available
-    //for each price we store a map with all the orders distinct by id, and corresponding size
-    //map <price : un_map <id : size> >
-    std::map<double, std::unordered_map<std::string, int>, comparatorBuy> buyMap_; 
-    std::map<double, std::unordered_map<std::string, int>, comparatorSell> sellMap_;
-    
-    //also keep all orders id in hash table, for each id we store the side (to pick the proper map) and the price, to find the element in the buy/sell maps
-    //map <id : <side, price> >
-    std::unordered_map<std::string, std::pair<Side, double>> hashTable_;
+template <size_t Width, class Overflow>
+void printLevelStats(const PriceLadder<Width, Overflow>& ladder, const char* name)
+{
+    const LadderStats& stats = ladder.stats();
+    std::cerr << name << " levels " << ladder.size() << " overflow levels " << ladder.overflow().size()
+              << " recenters " << stats.recenters << " spilled " << stats.spilled << " pulled " << stats.pulled
+              << " window hits " << stats.windowHits << " overflow hits " << stats.overflowHits << std::endl;
+}
 
+void printItchStats(const ItchStats& stats)
+{
+    std::cerr << "itch messages " << stats.messages << " adds " << stats.adds << " executions " << stats.executions
+              << " cancels " << stats.cancels << " deletes " << stats.deletes << " replaces " << stats.replaces
+              << " skipped " << stats.skipped << " truncated " << stats.truncated << std::endl;
+}
 
-    void handleNewOrder(const std::string& id, const Side side, const int size, const double price, const long timestamp) 
+template <class Analyzer>
+BookGauges bookGauges(const Analyzer& bookAnalyzer)
+{
+    BookGauges gauges;
+    gauges.orders = static_cast<long>(bookAnalyzer.hashTable_.size());
+    gauges.levels[Side::BUY] = static_cast<long>(bookAnalyzer.buyMap_.size());
+    gauges.levels[Side::SELL] = static_cast<long>(bookAnalyzer.sellMap_.size());
+    return gauges;
+}
+
+//parse the A/R/M/L text format line by line, poll() after every event
+template <class Analyzer, class Poll>
+bool readText(const Options& options, Analyzer& bookAnalyzer, Poll&& poll)
+{
+    std::ifstream infile(options.file);
+    if (!infile)
     {
-        if(side == Side::BUY)
-            handleNewBuyOrder(size, price, id, timestamp);
-        else if (side == Side::SELL)
-            handleNewSellOrder(size, price, id, timestamp);
-
-        hashTable_.insert(std::make_pair(id, std::make_pair(side, price))); //add id to hashmap if it doesn't exist
+        std::cerr << "cannot open " << options.file << std::endl;
+        return false;
     }
 
-    void reduceOrder(const std::string& id, const Side side, const int size, const long timestamp)
+    std::string line;
+    FeedEvent event;
+
+    bool more = true;
+    while (more) //process line by line until end of file, in chunks for the trace timeline
     {
-        auto hashElem = hashTable_.find(id);
-        auto price = hashElem->second.second;
-        bool removeFromMemory = false;
-
-        if (side == Side::BUY)
-            reduceBuyOrder(hashElem, price, size, timestamp, removeFromMemory);
-        else if (side == Side::SELL)
-            reduceSellOrder(hashElem, price, size, timestamp, removeFromMemory);
-        else 
+        TRACE_SCOPE("replay chunk");
+        for (size_t n = 0; n < FeedReader::BATCH_SIZE; ++n)
         {
-            //ignore, unknown order type
+            if (!(more = static_cast<bool>(std::getline(infile, line))))
+                break;
+            Metrics::count(Metric::BYTES_READ, line.size() + 1);
+            if (!(more = parseFeedEvent(line, event)))
+                break;
+            if (options.consolidated)
+                qualifyVenueId(event);
+            applyFeedEvent(bookAnalyzer, event);
+            poll();
         }
-
-        if (removeFromMemory)
-            hashTable_.erase(id); //remove order id from hashtable since there is no remaining size on market
     }
 
-private:
+    return true;
+}
 
-    std::unordered_map<std::string, int> createNewInnerMap(const std::string id, const int size) 
-    {
-        std::unordered_map<std::string, int> newMap;
-        newMap.emplace(std::make_pair(id, size)); 
-        return newMap;
-    }
+template <class Analyzer>
+void printBookStats(const Options& options, const Analyzer& bookAnalyzer)
+{
+    printLevelStats(bookAnalyzer.buyMap_, "buy");
+    printLevelStats(bookAnalyzer.sellMap_, "sell");
+    if (options.band > 0)
+        std::cerr << "band cold orders " << bookAnalyzer.coldOrders() << " cold levels " << bookAnalyzer.coldLevels()
+                  << " parked " << bookAnalyzer.parked_ << " promoted " << bookAnalyzer.promoted_ << std::endl;
+}
+
+template <class Levels, class Params, class Index>
+int runParallel(const Options& options, const Params& params)
+{
+    typedef BookAnalyzer<Levels, Params, Index> Analyzer;
+    OutputWriter::standardOutput().flush();
 
-    void searchInnerMap(std::unordered_map<std::string, int> innerMap, double price, long timestamp, double& prevOut, double& amount, int& currSize)
+    MetricsDump metrics(options.metricsFile, options.metricsEvery);
+    bool read = replayParallel(options.file, options.parallel, [&options, &params](OutputWriter& out)
     {
-        int localSize=0;
-        auto innerMapIter = innerMap.begin();
-        while(localSize<(target_-currSize) && innerMapIter!= innerMap.end())
-        {
-            localSize += innerMapIter->second;
-            ++innerMapIter;
-        }
-        
-        if(localSize>(target_-currSize))
-            localSize = target_-currSize;
-
-        amount += localSize * price;
-        currSize += localSize;
+        std::unique_ptr<Analyzer> bookAnalyzer(new Analyzer(params, out));
+        bookAnalyzer->printTop_ = options.top;
+        return bookAnalyzer;
+    }, std::cout, [&metrics](const Analyzer& bookAnalyzer)
+    {
+        metrics.poll([&bookAnalyzer] { return bookGauges(bookAnalyzer); });
+    }, [&options, &metrics](const Analyzer& bookAnalyzer)
+    {
+        if (options.metricsEvery > 0 || !options.metricsFile.empty())
+            metrics.dump(bookGauges(bookAnalyzer));
+        else
+            metrics.poll([&bookAnalyzer] { return bookGauges(bookAnalyzer); }); //a SIGUSR1 after the pre-pass
+        if (options.stats)
+            printBookStats(options, bookAnalyzer);
+    });
+
+    if (!read)
+    {
+        std::cerr << "cannot open " << options.file << std::endl;
+        return 1;
     }
+    return 0;
+}
 
-    void printNA(const long timestamp, bool& prevNan, Side side)
+template <class Levels, class Params, class Index>
+int run(const Options& options, const Params& params)
+{
+    if (options.parallel > 1)
+        return runParallel<Levels, Params, Index>(options, params);
+
+    typedef BookAnalyzer<Levels, Params, Index> Analyzer;
+    Analyzer bookAnalyzer(params);
+    bookAnalyzer.printTop_ = options.top;
+    bookAnalyzer.matching_ = options.match;
+    bookAnalyzer.consolidated_ = options.consolidated;
+    bookAnalyzer.bucketTicks_ = options.approximate;
+    bookAnalyzer.bandTicks_ = options.band;
+
+    MetricsDump metrics(options.metricsFile, options.metricsEvery);
+    auto poll = [&metrics, &bookAnalyzer]
     {
-        prevNan = true;
-        std::cout << timestamp << (side == Side::BUY ? " S" : " B") << " NA" << std::endl; 
-    }
+        metrics.poll([&bookAnalyzer] { return bookGauges(bookAnalyzer); });
+    };
 
-    void print(const double& amount, double& prevAmount, bool& prevIsNan, const long timestamp, const Side side)
+    if (options.pcap)
     {
-        if (amount != prevAmount || prevIsNan == true)
-            std::cout << timestamp << " " << (side == Side::BUY ? "S" :"B") << " " << amount << std::endl;
+        PcapReader reader;
+        if (!reader.open(options.file))
+        {
+            std::cerr << "cannot open " << options.file << " as a pcap/pcapng capture" << std::endl;
+            return 1;
+        }
 
-        prevAmount = amount;
-        prevIsNan = false;
-    }
+        ItchDecoder<Analyzer> decoder(bookAnalyzer, options.symbol);
+        MoldUdp64Payload<ItchDecoder<Analyzer>> payload(decoder);
+        const bool paced = options.pace > 0;
+        reader.replay(options.port, [&payload, &poll, paced](const uint8_t* data, const size_t length)
+        {
+            payload(data, length);
+            if (paced)
+                OutputWriter::standardOutput().flush(); //the lines of a packet go out when it is replayed, not when the buffer fills
+            poll();
+        }, options.pace);
 
-    void printBuy(long timestamp)
+        if (options.stats)
+        {
+            const PcapStats& stats = reader.stats();
+            std::cerr << "pcap packets " << stats.packets << " delivered " << stats.delivered << " other port " << stats.otherPort
+                      << " not udp " << stats.notUdp << " truncated " << stats.truncated << " sequence gaps " << payload.gaps()
+                      << " duplicates " << payload.duplicates() << std::endl;
+            printItchStats(decoder.stats());
+        }
+    }
+    else if (options.itch)
     {
-        int currSize=0;
-        double income = 0;
-        auto it = buyMap_.begin();
-
-        while(currSize<target_ && it!=buyMap_.end())
+        ItchDecoder<Analyzer> decoder(bookAnalyzer, options.symbol);
+        if (!decoder.decodeFile(options.file, poll))
         {
-            searchInnerMap(it->second, it->first, timestamp, prevIncome_, income, currSize);
-            ++it;
+            std::cerr << "cannot open " << options.file << std::endl;
+            return 1;
         }
 
-        print(income, prevExpenses_, prevNanExp_, timestamp, Side::BUY);
+        if (options.stats)
+            printItchStats(decoder.stats());
     }
-
-    void printSell(long timestamp)
+    else if (!options.merge.empty())
     {
-        int currSize=0;
-        double expenses = 0;
-        auto it = sellMap_.begin();
-
-        while(currSize<target_ && it!=sellMap_.end())
+        FeedMerge merge(options.merge, options.consolidated);
+        for (const std::string& file : merge.failed(options.merge))
         {
-            searchInnerMap(it->second, it->first, timestamp, prevExpenses_, expenses, currSize);
-            ++it;
+            std::cerr << "cannot open " << file << std::endl;
+            return 1;
         }
 
-        print(expenses, prevIncome_, prevNanIncome_, timestamp, Side::SELL);
+        long events = merge.run([&bookAnalyzer, &options, &poll](FeedEvent& event)
+        {
+            if (options.consolidated)
+                qualifyVenueId(event);
+            applyFeedEvent(bookAnalyzer, event);
+            poll();
+        });
+
+        if (options.stats)
+            std::cerr << "merged " << options.merge.size() << " feeds, " << events << " events" << std::endl;
     }
-    
-    void handleNewBuyOrder(const int size, const double price, const std::string id, const long timestamp)
+    else if (!readText(options, bookAnalyzer, poll))
     {
-        totBuySize_ += size;
-        auto buyIter = buyMap_.find(price);
-
-        if (buyIter != buyMap_.end())
-            buyIter->second.insert(std::make_pair(id, size));
-        else 
-            buyMap_.emplace(std::make_pair(price, createNewInnerMap(id, size)));
-
-        if (target_<=totBuySize_)
-            printBuy(timestamp);
+        return 1;
     }
 
-    void handleNewSellOrder(const int size, const double price, const std::string id, long timestamp)
-    {
-        totSellSize_ += size;
-        auto sellIter = sellMap_.find(price);
+    if (options.metricsEvery > 0 || !options.metricsFile.empty())
+        metrics.dump(bookGauges(bookAnalyzer));
 
-        if (sellIter != sellMap_.end())
-            sellIter->second.insert(std::make_pair(id, size));
-        else 
-            sellMap_.emplace(std::make_pair(price, this->createNewInnerMap(id, size)));
+    if (options.stats)
+        printBookStats(options, bookAnalyzer);
 
-        if (target_<=totSellSize_)
-            printSell(timestamp);
-    }
+    return 0;
+}
 
-    bool searchId(std::unordered_map<std::string, int>& innerMap, const std::string& id, const int size, bool& removeFromMemory, int& totSize, const Side side)
+template <class Levels, class Index>
+int runPortfolio(const Options& options)
+{
+    std::ifstream infile(options.portfolio);
+    if (!infile)
     {
-        auto idIter = innerMap.find(id);
-        if (idIter != innerMap.end())
-        {
-            idIter->second -= size;
-
-            if (idIter->second <= 0)
-            {
-                innerMap.erase(id);
+        std::cerr << "cannot open " << options.portfolio << std::endl;
+        return 1;
+    }
 
-                if (innerMap.empty())
-                    removeFromMemory = true;
-            }
+    Portfolio<Levels, Index> portfolio(OutputWriter::standardOutput(), feedTickScale(options));
+    std::vector<std::string> feeds;
+    std::string line;
 
-            totSize -= size;
-            return true;
+    while (std::getline(infile, line))
+    {
+        std::istringstream fields(line);
+        std::string symbol, feed;
+        long position = 0;
+        if (!(fields >> symbol))
+            continue;
+        if (!(fields >> position >> feed) || position == 0 || position > Portfolio<Levels, Index>::MAX_POSITION
+            || position < -Portfolio<Levels, Index>::MAX_POSITION)
+        {
+            std::cerr << "bad position " << line << std::endl;
+            return 1;
         }
-
-        return false;
+        portfolio.addInstrument(symbol, position);
+        feeds.push_back(feed);
     }
 
-    void reduceBuyOrder(std::unordered_map<std::string, std::pair<Side, double>>::iterator& hashElem, const double price, const int size, const long timestamp, bool& removeFromMemory)
+    FeedMerge merge(feeds, true); //the venue tag of an event is the index of its instrument
+    for (const std::string& file : merge.failed(feeds))
     {
-         auto iter = buyMap_.find(price);
+        std::cerr << "cannot open " << file << std::endl;
+        return 1;
+    }
 
-        if(iter != buyMap_.end())
+    MetricsDump metrics(options.metricsFile, options.metricsEvery);
+    auto gauges = [&portfolio]
+    {
+        BookGauges total;
+        for (size_t i = 0; i < portfolio.size(); ++i)
         {
-            if (searchId(iter->second, hashElem->first, size, removeFromMemory, totBuySize_, Side::BUY)) // look for the order to reduce by id
-            {
-                if (target_ <= totBuySize_)
-                    printBuy(timestamp);
-                else if (target_ > totBuySize_ && prevNanExp_ == false)
-                    printNA(timestamp, prevNanExp_, Side::BUY);
-            }
+            BookGauges book = bookGauges(portfolio.book(i));
+            total.orders += book.orders;
+            total.levels[Side::BUY] += book.levels[Side::BUY];
+            total.levels[Side::SELL] += book.levels[Side::SELL];
         }
+        return total;
+    };
 
-        if (removeFromMemory)
-            buyMap_.erase(price);
-    }
+    long events = merge.run([&portfolio, &metrics, &gauges](FeedEvent& event)
+    {
+        size_t instrument = static_cast<size_t>(event.venue);
+        event.venue = 0;
+        portfolio.apply(instrument, event);
+        metrics.poll(gauges);
+    });
+
+    if (options.metricsEvery > 0 || !options.metricsFile.empty())
+        metrics.dump(gauges());
 
-    void reduceSellOrder(std::unordered_map<std::string, std::pair<Side, double>>::iterator& hashElem, const double& price, const int size, const long timestamp, bool& removeFromMemory)
+    if (options.stats)
     {
-        auto iter = sellMap_.find(price);
+        long walks = 0;
+        for (size_t i = 0; i < portfolio.size(); ++i)
+            walks += portfolio.book(i).walks_;
+        std::cerr << "portfolio of " << portfolio.size() << " positions, " << events << " events, " << walks << " target walks"
+                  << std::endl;
+    }
 
-        if(iter != sellMap_.end())
-        {
-            if (searchId(iter->second, hashElem->first, size, removeFromMemory, totSellSize_, Side::SELL)) // look for the order to reduce by id
-            {
-                if (target_<= totSellSize_)
-                    printSell(timestamp);
-                else if (target_ > totSellSize_ && prevNanIncome_ == false)
-                    printNA(timestamp, prevNanIncome_, Side::SELL);
-            }
-        }
+    return 0;
+}
 
-        if (removeFromMemory)
-            sellMap_.erase(price);
+template <class Params>
+int runBook(const Options& options, const Params& params)
+{
+    int status = 1;
+    if (!selectEngine(options.book, options.index, [&options, &params, &status](auto engine)
+        {
+            status = run<typename decltype(engine)::Levels, Params, typename decltype(engine)::Index>(options, params);
+        }))
+    {
+        std::cerr << "unknown book " << options.book << " or index " << options.index << std::endl;
     }
-};
+    return status;
+}
 
-int main() 
+//replay the feeds into the book (or the portfolio books) the options ask for
+int replay(Options& options)
 {
-    std::cout << std::setprecision(2) << std::fixed;
-    int target = 200;
-    BookAnalyzer bookAnalyzer = BookAnalyzer(target);
 
-    std::ifstream infile("book_analyzer.in");
+    if (!options.portfolio.empty())
+    {
+        int status = 1;
+        if (!selectEngine(options.book, options.index, [&options, &status](auto engine)
+            {
+                status = runPortfolio<typename decltype(engine)::Levels, typename decltype(engine)::Index>(options);
+            }))
+        {
+            std::cerr << "unknown book " << options.book << " or index " << options.index << std::endl;
+        }
+        return status;
+    }
 
-    long timestamp;
-    char type;
-    std::string id;
-    Side side;
-    double price;
-    int size;
-    std::string line;
-    
-    while (std::getline(infile, line)) //process line by line until end of file
+    if (options.merge.size() == 1)
+        options.file = options.merge[0];
+    if (options.merge.size() <= 1)
+        options.merge.clear();
+
+    if (options.parallel > 1 && (options.itch || options.pcap || !options.merge.empty() || options.match || options.consolidated
+                                 || options.approximate > 0 || options.band > 0))
     {
-        std::istringstream iss(line);
-        if (!(iss >> timestamp >> type)) 
-            break;
+        std::cerr << "--parallel replays a single text feed, without --match, --consolidated, --approximate or --band" << std::endl;
+        return 1;
+    }
 
-        if (type == 'A') //if new order process it
-        {
-            char tempSide;
-            iss >> id >> tempSide >> price >> size;
+    const long tickScale = feedTickScale(options);
+    if (options.notional > 0)
+        return runBook(options, RuntimeParams(options.target, tickScale, std::llround(options.notional * tickScale)));
 
-            side = tempSide == 'B' ? Side::BUY : Side::SELL;
+#ifdef FIXED_TARGET
+#ifndef FIXED_TICK_SCALE
+#define FIXED_TICK_SCALE TICK_SCALE
+#endif
+    if (options.target == FIXED_TARGET && tickScale == FIXED_TICK_SCALE)
+        return runBook(options, FixedParams<FIXED_TARGET, FIXED_TICK_SCALE>());
+#endif
 
-            bookAnalyzer.handleNewOrder(id, side, size, price, timestamp);
-            
-        }
-        else if (type == 'R') //else reduce existing order
-        {
-            iss >> id >> size;
+    return runBook(options, RuntimeParams(options.target, tickScale));
+}
 
-            auto hashElem = bookAnalyzer.hashTable_.find(id);
+int main(int argc, char** argv)
+{
+    Options options;
 
-            if (hashElem != bookAnalyzer.hashTable_.end())
-            {
-                Side side = hashElem->second.first;
-                bookAnalyzer.reduceOrder(id, side, size, timestamp);
-            }
-            else 
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--target") == 0 && i + 1 < argc)
+            options.target = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--notional") == 0 && i + 1 < argc)
+            options.notional = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--tick-scale") == 0 && i + 1 < argc)
+        {
+            options.tickScale = std::atol(argv[++i]);
+            if (options.tickScale <= 0)
             {
-                //ignore, order id not found
+                std::cerr << "--tick-scale must be positive" << std::endl;
+                return 1;
             }
         }
+        else if (std::strcmp(argv[i], "--book") == 0 && i + 1 < argc)
+            options.book = argv[++i];
+        else if (std::strcmp(argv[i], "--index") == 0 && i + 1 < argc)
+            options.index = argv[++i];
+        else if (std::strcmp(argv[i], "--itch") == 0)
+            options.itch = true;
+        else if (std::strcmp(argv[i], "--pcap") == 0)
+            options.pcap = true;
+        else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            options.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--pace") == 0 && i + 1 < argc)
+            options.pace = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--symbol") == 0 && i + 1 < argc)
+            options.symbol = argv[++i];
+        else if (std::strcmp(argv[i], "--consolidated") == 0)
+            options.consolidated = true;
+        else if (std::strcmp(argv[i], "--match") == 0)
+            options.match = true;
+        else if (std::strcmp(argv[i], "--top") == 0)
+            options.top = true;
+        else if (std::strcmp(argv[i], "--approximate") == 0 && i + 1 < argc)
+            options.approximate = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--band") == 0 && i + 1 < argc)
+            options.band = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--parallel") == 0 && i + 1 < argc)
+            options.parallel = static_cast<size_t>(std::max(std::atol(argv[++i]), 0L));
+        else if (std::strcmp(argv[i], "--stats") == 0)
+            options.stats = true;
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            options.trace = argv[++i];
+        else if (std::strcmp(argv[i], "--trace-sample") == 0 && i + 1 < argc)
+            options.traceSample = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc)
+            options.metricsFile = argv[++i];
+        else if (std::strcmp(argv[i], "--metrics-every") == 0 && i + 1 < argc)
+            options.metricsEvery = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--portfolio") == 0 && i + 1 < argc)
+            options.portfolio = argv[++i];
+        else if (argv[i][0] != '-')
+            options.merge.push_back(argv[i]);
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
     }
 
-    return 0;
-}
\ No newline at end of file
+    if (options.trace.empty())
+        return replay(options);
+
+#ifdef BOOK_TRACE
+    Tracer::instance().start(options.traceSample);
+    TRACE_THREAD_NAME("replay");
+    int status = replay(options);
+    OutputWriter::standardOutput().flush();
+
+    if (!Tracer::instance().write(options.trace))
+    {
+        std::cerr << "cannot write " << options.trace << std::endl;
+        return 1;
+    }
+    if (Tracer::instance().dropped() > 0)
+        std::cerr << "trace buffers full, " << Tracer::instance().dropped() << " events dropped" << std::endl;
+    return status;
+#else
+    std::cerr << "--trace needs a build with -DBOOK_TRACE" << std::endl;
+    return 1;
+#endif
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+Live counters of a run, dumped in the Prometheus text format on SIGUSR1 and periodically (see MetricsDump).
+
+Every thread counts into its own block, registered under a lock the first time the thread counts, and only that thread
+writes it: an increment is a relaxed load and store on a cache line no other thread writes, no lock and no atomic
+read-modify-write. The blocks are merged only when a dump is taken; the counters of the other threads (the feed readers)
+may then be slightly behind.
+
+The gauges (live orders, live levels per side) are not counted: the replay thread reads them from its books when it dumps.
+*/
+
+enum class Metric : uint8_t
+{
+    ADDS,
+    REDUCES,
+    MODIFIES,
+    LEVEL_UPDATES,
+    REPLACES,
+    UNKNOWN_REDUCES, //reduces of an order id that is not in the book, skipped
+    LINES, //output lines written
+    NA_TRANSITIONS, //a side going from an amount to NA
+    BYTES_READ,
+    COUNT
+};
+
+struct alignas(64) MetricBlock
+{
+    MetricBlock()
+    {
+        for (std::atomic<uint64_t>& value : values)
+            value.store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> values[static_cast<size_t>(Metric::COUNT)];
+};
+
+class Metrics
+{
+public:
+
+    //never destroyed, threads may still count during static destruction (the output writer flushes at exit)
+    static Metrics& instance()
+    {
+        static Metrics* metrics = new Metrics();
+        return *metrics;
+    }
+
+    static void count(const Metric metric, const uint64_t n = 1)
+    {
+        std::atomic<uint64_t>& value = local().values[static_cast<size_t>(metric)];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    //sum over the threads
+    uint64_t total(const Metric metric) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t result = 0;
+        for (const std::unique_ptr<MetricBlock>& block : blocks_)
+            result += block->values[static_cast<size_t>(metric)].load(std::memory_order_relaxed);
+        return result;
+    }
+
+private:
+
+    Metrics() = default;
+
+    //the block of the calling thread, registered on its first count
+    static MetricBlock& local()
+    {
+        thread_local MetricBlock* block = nullptr;
+        if (block == nullptr)
+            block = instance().add();
+        return *block;
+    }
+
+    MetricBlock* add()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks_.emplace_back(new MetricBlock());
+        return blocks_.back().get();
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<MetricBlock>> blocks_;
+};
+
+//what the books hold at the time of a dump
+struct BookGauges
+{
+    long orders = 0;
+    long levels[2] = {0, 0}; //indexed by Side
+};
+
+/*
+Dumps the metrics to a file (rewritten whole, through a rename, so that a scraper never reads half a dump) or to stderr.
+The replay thread polls between events: a dump is taken when SIGUSR1 arrived since the last poll or when the period elapsed
+(the clock is read once every CLOCK_POLLS polls). A run waiting for its input (a paced replay) dumps at its next event.
+*/
+class MetricsDump
+{
+public:
+
+    static const unsigned CLOCK_POLLS = 1024;
+
+    //file empty for stderr, period 0 to dump on SIGUSR1 only
+    MetricsDump(const std::string& file, const double periodSeconds)
+        : file_(file), start_(std::chrono::steady_clock::now()), polls_(0),
+          period_(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(periodSeconds))),
+          next_(start_ + period_)
+    {
+        std::signal(SIGUSR1, &MetricsDump::request);
+    }
+
+    ~MetricsDump()
+    {
+        std::signal(SIGUSR1, SIG_DFL);
+    }
+
+    MetricsDump(const MetricsDump&) = delete;
+    MetricsDump& operator=(const MetricsDump&) = delete;
+
+    //gauges() returns the BookGauges of the books, called only when a dump is due
+    template <class Gauges>
+    void poll(Gauges&& gauges)
+    {
+        bool due = false;
+        if (requested_.load(std::memory_order_relaxed))
+        {
+            requested_.store(false, std::memory_order_relaxed);
+            due = true;
+        }
+        if (period_.count() > 0 && ++polls_ % CLOCK_POLLS == 0)
+        {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now >= next_)
+            {
+                next_ = now + period_;
+                due = true;
+            }
+        }
+
+        if (due)
+            dump(gauges());
+    }
+
+    void dump(const BookGauges& gauges) const
+    {
+        const Metrics& metrics = Metrics::instance();
+        std::ostringstream out;
+
+        out << "# TYPE book_analyzer_events_total counter\n";
+        out << "book_analyzer_events_total{type=\"add\"} " << metrics.total(Metric::ADDS) << "\n";
+        out << "book_analyzer_events_total{type=\"reduce\"} " << metrics.total(Metric::REDUCES) << "\n";
+        out << "book_analyzer_events_total{type=\"modify\"} " << metrics.total(Metric::MODIFIES) << "\n";
+        out << "book_analyzer_events_total{type=\"level\"} " << metrics.total(Metric::LEVEL_UPDATES) << "\n";
+        out << "book_analyzer_events_total{type=\"replace\"} " << metrics.total(Metric::REPLACES) << "\n";
+        out << "# TYPE book_analyzer_unknown_reduces_total counter\n";
+        out << "book_analyzer_unknown_reduces_total " << metrics.total(Metric::UNKNOWN_REDUCES) << "\n";
+        out << "# TYPE book_analyzer_lines_total counter\n";
+        out << "book_analyzer_lines_total " << metrics.total(Metric::LINES) << "\n";
+        out << "# TYPE book_analyzer_na_transitions_total counter\n";
+        out << "book_analyzer_na_transitions_total " << metrics.total(Metric::NA_TRANSITIONS) << "\n";
+        out << "# TYPE book_analyzer_read_bytes_total counter\n";
+        out << "book_analyzer_read_bytes_total " << metrics.total(Metric::BYTES_READ) << "\n";
+        out << "# TYPE book_analyzer_live_orders gauge\n";
+        out << "book_analyzer_live_orders " << gauges.orders << "\n";
+        out << "# TYPE book_analyzer_live_levels gauge\n";
+        out << "book_analyzer_live_levels{side=\"buy\"} " << gauges.levels[0] << "\n";
+        out << "book_analyzer_live_levels{side=\"sell\"} " << gauges.levels[1] << "\n";
+        out << "# TYPE book_analyzer_uptime_seconds gauge\n";
+        out << "book_analyzer_uptime_seconds "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count() << "\n";
+
+        if (file_.empty())
+        {
+            std::cerr << out.str() << std::flush;
+            return;
+        }
+
+        std::string temporary = file_ + ".tmp";
+        {
+            std::ofstream outfile(temporary);
+            outfile << out.str();
+            if (!outfile)
+            {
+                std::cerr << "cannot write " << temporary << std::endl;
+                return;
+            }
+        }
+        if (std::rename(temporary.c_str(), file_.c_str()) != 0)
+            std::cerr << "cannot write " << file_ << std::endl;
+    }
+
+private:
+
+    static void request(int)
+    {
+        requested_.store(true, std::memory_order_relaxed);
+    }
+
+    static inline std::atomic<bool> requested_{false}; //lock free, set from the signal handler
+
+    std::string file_;
+    std::chrono::steady_clock::time_point start_;
+    unsigned polls_;
+    std::chrono::steady_clock::duration period_;
+    std::chrono::steady_clock::time_point next_;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+Hierarchical occupancy bitmap over Bits slots, used by the price ladder to find the next non-empty level.
+
+Three levels of 64 bit words:
+- words_ has one bit per slot;
+- summary_ has one bit per word of words_, set when the word is not zero;
+- top_ has one bit per word of summary_, set when the summary word is not zero.
+
+set/clear touch at most one word per level, nextSet is at most three count-trailing-zeros,
+so finding the next occupied level costs the same however large the gap to it is.
+*/
+
+template <size_t Bits>
+class OccupancyBitmap
+{
+    static const size_t WORDS = (Bits + 63) / 64;
+    static const size_t SUMMARY_WORDS = (WORDS + 63) / 64;
+
+    static_assert(SUMMARY_WORDS <= 64, "occupancy bitmap supports up to 64^3 slots");
+
+public:
+
+    static const size_t NONE = Bits;
+
+    OccupancyBitmap() : top_(0)
+    {
+        for (size_t i = 0; i < WORDS; ++i)
+            words_[i] = 0;
+        for (size_t i = 0; i < SUMMARY_WORDS; ++i)
+            summary_[i] = 0;
+    }
+
+    bool test(const size_t pos) const
+    {
+        return (words_[pos >> 6] >> (pos & 63)) & 1;
+    }
+
+    void set(const size_t pos)
+    {
+        size_t word = pos >> 6;
+        words_[word] |= bit(pos);
+        summary_[word >> 6] |= bit(word);
+        top_ |= bit(word >> 6);
+    }
+
+    void clear(const size_t pos)
+    {
+        size_t word = pos >> 6;
+        words_[word] &= ~bit(pos);
+        if (words_[word] != 0)
+            return;
+
+        summary_[word >> 6] &= ~bit(word);
+        if (summary_[word >> 6] == 0)
+            top_ &= ~bit(word >> 6);
+    }
+
+    bool any() const { return top_ != 0; }
+
+    //first set position >= pos, NONE if there is none
+    size_t nextSet(const size_t pos) const
+    {
+        if (pos >= Bits)
+            return NONE;
+
+        size_t word = pos >> 6;
+        uint64_t bits = words_[word] & (~uint64_t(0) << (pos & 63));
+        if (bits != 0)
+            return (word << 6) + ctz(bits);
+
+        //next non-empty word in the same summary word
+        size_t next = word + 1;
+        if (next < WORDS && (next & 63) != 0)
+        {
+            uint64_t summary = summary_[next >> 6] & (~uint64_t(0) << (next & 63));
+            if (summary != 0)
+                return firstIn(((next >> 6) << 6) + ctz(summary));
+        }
+
+        //next non-empty summary word
+        size_t summaryWord = (next + 63) >> 6;
+        if (summaryWord >= SUMMARY_WORDS)
+            return NONE;
+
+        uint64_t top = top_ & (~uint64_t(0) << summaryWord);
+        if (top == 0)
+            return NONE;
+
+        summaryWord = ctz(top);
+        return firstIn((summaryWord << 6) + ctz(summary_[summaryWord]));
+    }
+
+    //first set position at or after pos going around the end, NONE if the bitmap is empty
+    size_t nextSetCircular(const size_t pos) const
+    {
+        size_t found = nextSet(pos);
+        return found != NONE || pos == 0 ? found : nextSet(0);
+    }
+
+private:
+
+    static uint64_t bit(const size_t pos)
+    {
+        return uint64_t(1) << (pos & 63);
+    }
+
+    static size_t ctz(const uint64_t bits)
+    {
+        return static_cast<size_t>(__builtin_ctzll(bits));
+    }
+
+    size_t firstIn(const size_t word) const
+    {
+        return (word << 6) + ctz(words_[word]);
+    }
+
+    uint64_t words_[WORDS];
+    uint64_t summary_[SUMMARY_WORDS];
+    uint64_t top_;
+};
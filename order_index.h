@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+Order id indexes: id -> handle of the order in the order store, a template parameter of the engine (BookAnalyzer).
+
+All of them offer the same small interface, positions stand for an entry until the next insert or erase:
+  Position find(id)         where id is, check it with found()
+  bool found(position)
+  uint32_t& handle(position)     (and a const overload, find is const too)
+  std::pair<Position, bool> insert(id)   where id is, and whether it was inserted now (with handle 0)
+  void erase(position)
+  size_t size()
+
+StdOrderIndex      std::unordered_map, one node per order;
+FlatOrderIndex     open addressing with linear probing, the ids and handles in one array, at most 7/8 full;
+                   erasing shifts the following entries back instead of leaving tombstones, so probes stay short;
+DirectOrderIndex   ids that encode a number index a vector of handles directly, a perfect hash when ids are handed out
+                   in sequence: decimal ids (ITCH reference numbers) and lowercase ids written little-endian in base 26,
+                   'a' for 0, as the sample and the synthetic feeds do ("b" is 1, "ab" is 26). The vectors grow up to
+                   the largest id seen, ids of another form or beyond MAX_DIRECT go to a FlatOrderIndex.
+*/
+
+class StdOrderIndex
+{
+public:
+
+    typedef std::unordered_map<std::string, uint32_t>::iterator Position;
+
+    Position find(const std::string& id) const { return map_.find(id); }
+    bool found(const Position position) const { return position != map_.end(); }
+    uint32_t& handle(const Position position) { return position->second; }
+    uint32_t handle(const Position position) const { return position->second; }
+    std::pair<Position, bool> insert(const std::string& id) { return map_.emplace(id, 0); }
+    void erase(const Position position) { map_.erase(position); }
+    size_t size() const { return map_.size(); }
+
+private:
+
+    mutable std::unordered_map<std::string, uint32_t> map_; //a position from a const find is the same iterator type
+};
+
+class FlatOrderIndex
+{
+public:
+
+    typedef size_t Position;
+
+    static const size_t NONE = ~size_t(0);
+
+    FlatOrderIndex() : slots_(MIN_CAPACITY), size_(0)
+    {   }
+
+    Position find(const std::string& id) const
+    {
+        const size_t hash = std::hash<std::string>()(id);
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            const Slot& slot = slots_[i];
+            if (!slot.used)
+                return NONE;
+            if (slot.hash == hash && slot.id == id)
+                return i;
+        }
+    }
+
+    bool found(const Position position) const { return position != NONE; }
+    uint32_t& handle(const Position position) { return slots_[position].handle; }
+    uint32_t handle(const Position position) const { return slots_[position].handle; }
+
+    std::pair<Position, bool> insert(const std::string& id)
+    {
+        if ((size_ + 1) * 8 > slots_.size() * 7)
+            rehash(2 * slots_.size());
+
+        const size_t hash = std::hash<std::string>()(id);
+        const size_t mask = slots_.size() - 1;
+        size_t i = hash & mask;
+        for (; slots_[i].used; i = (i + 1) & mask)
+        {
+            if (slots_[i].hash == hash && slots_[i].id == id)
+                return std::make_pair(i, false);
+        }
+
+        Slot& slot = slots_[i];
+        slot.used = true;
+        slot.hash = hash;
+        slot.handle = 0;
+        slot.id = id;
+        ++size_;
+        return std::make_pair(i, true);
+    }
+
+    //backward shift: the entries after the erased one move back into the hole as long as that keeps them
+    //at or after their home slot
+    void erase(const Position position)
+    {
+        const size_t mask = slots_.size() - 1;
+        size_t hole = position;
+        for (size_t i = (hole + 1) & mask; slots_[i].used; i = (i + 1) & mask)
+        {
+            size_t home = slots_[i].hash & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask))
+            {
+                std::swap(slots_[hole], slots_[i]);
+                hole = i;
+            }
+        }
+        slots_[hole].used = false;
+        --size_;
+    }
+
+    size_t size() const { return size_; }
+
+private:
+
+    static const size_t MIN_CAPACITY = 1024; //a power of two
+
+    struct Slot
+    {
+        size_t hash = 0;
+        uint32_t handle = 0;
+        bool used = false;
+        std::string id;
+    };
+
+    void rehash(const size_t capacity)
+    {
+        std::vector<Slot> old(capacity);
+        old.swap(slots_);
+        const size_t mask = capacity - 1;
+        for (Slot& slot : old)
+        {
+            if (!slot.used)
+                continue;
+            size_t i = slot.hash & mask;
+            while (slots_[i].used)
+                i = (i + 1) & mask;
+            slots_[i] = std::move(slot);
+        }
+    }
+
+    std::vector<Slot> slots_;
+    size_t size_;
+};
+
+class DirectOrderIndex
+{
+public:
+
+    //scheme in the top 2 bits (decimal, base 26 or flat), number or flat position below
+    typedef size_t Position;
+
+    static const size_t MAX_DIRECT = size_t(1) << 24; //entries per vector, 64MB of handles
+    static const Position NONE = ~size_t(0);
+
+    DirectOrderIndex() : direct_(0)
+    {   }
+
+    Position find(const std::string& id) const
+    {
+        size_t scheme, number;
+        if (!decode(id, scheme, number))
+        {
+            FlatOrderIndex::Position position = flat_.find(id);
+            return flat_.found(position) ? (FLAT << SCHEME_SHIFT) | position : NONE;
+        }
+
+        const std::vector<uint32_t>& handles = handles_[scheme];
+        return number < handles.size() && handles[number] != EMPTY ? (scheme << SCHEME_SHIFT) | number : NONE;
+    }
+
+    bool found(const Position position) const { return position != NONE; }
+
+    uint32_t& handle(const Position position)
+    {
+        const size_t scheme = position >> SCHEME_SHIFT;
+        const size_t number = position & NUMBER_MASK;
+        return scheme == FLAT ? flat_.handle(number) : handles_[scheme][number];
+    }
+
+    uint32_t handle(const Position position) const
+    {
+        return const_cast<DirectOrderIndex*>(this)->handle(position);
+    }
+
+    std::pair<Position, bool> insert(const std::string& id)
+    {
+        size_t scheme, number;
+        if (!decode(id, scheme, number))
+        {
+            std::pair<FlatOrderIndex::Position, bool> inserted = flat_.insert(id);
+            return std::make_pair((FLAT << SCHEME_SHIFT) | inserted.first, inserted.second);
+        }
+
+        std::vector<uint32_t>& handles = handles_[scheme];
+        if (number >= handles.size())
+            handles.resize(std::min(std::max(number + 1, 2 * handles.size()), size_t(MAX_DIRECT)), uint32_t(EMPTY));
+
+        Position position = (scheme << SCHEME_SHIFT) | number;
+        if (handles[number] != EMPTY)
+            return std::make_pair(position, false);
+
+        handles[number] = 0;
+        ++direct_;
+        return std::make_pair(position, true);
+    }
+
+    void erase(const Position position)
+    {
+        const size_t scheme = position >> SCHEME_SHIFT;
+        const size_t number = position & NUMBER_MASK;
+        if (scheme == FLAT)
+        {
+            flat_.erase(number);
+            return;
+        }
+
+        handles_[scheme][number] = EMPTY;
+        --direct_;
+    }
+
+    size_t size() const { return direct_ + flat_.size(); }
+
+private:
+
+    static const size_t DECIMAL = 0;
+    static const size_t LETTERS = 1;
+    static const size_t FLAT = 2;
+    static const int SCHEME_SHIFT = 62;
+    static const size_t NUMBER_MASK = (size_t(1) << SCHEME_SHIFT) - 1;
+    static const uint32_t EMPTY = ~uint32_t(0);
+
+    //the number an id encodes, false for ids of another form (leading zeros, a trailing 'a' and too large numbers included,
+    //so that every number has a single id)
+    static bool decode(const std::string& id, size_t& scheme, size_t& number)
+    {
+        if (id.empty())
+            return false;
+
+        number = 0;
+        if (id[0] >= '0' && id[0] <= '9')
+        {
+            if (id[0] == '0' && id.size() > 1)
+                return false;
+            for (char c : id)
+            {
+                if (c < '0' || c > '9')
+                    return false;
+                number = 10 * number + static_cast<size_t>(c - '0');
+                if (number >= MAX_DIRECT)
+                    return false;
+            }
+            scheme = DECIMAL;
+        }
+        else
+        {
+            if (id.size() > 1 && id.back() == 'a')
+                return false;
+            for (size_t i = id.size(); i > 0; --i)
+            {
+                char c = id[i - 1];
+                if (c < 'a' || c > 'z')
+                    return false;
+                number = 26 * number + static_cast<size_t>(c - 'a');
+                if (number >= MAX_DIRECT)
+                    return false;
+            }
+            scheme = LETTERS;
+        }
+
+        return true;
+    }
+
+    std::vector<uint32_t> handles_[2]; //by scheme
+    size_t direct_; //ids in handles_
+    FlatOrderIndex flat_;
+};
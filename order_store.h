@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "book_levels.h"
+
+/*
+Storage of the resting orders, indexed by handle.
+
+Every order has a hot part (OrderInfo, 24 bytes: tick, remaining size, queue slot, handle, side, venue), all that adds,
+reduces, modifies and the matching loop touch, and a cold part (OrderRecord: the id, the original size and the entry
+timestamp) read only to print trade records and for reports.
+By default both parts of an order are kept together in one array, as one record per order.
+Building with -DBOOK_SPLIT_ORDERS puts them in two arrays indexed by the same handle, so that the hot records
+of consecutive orders share cache lines. It is not the default: with random reduces over 1M to 4M live orders
+it measured slower than whole records when it was introduced (bench/order_store.cpp), and no cache miss counts
+were available to show a gain.
+
+The id is only needed to print trade records (matching mode) and to write checkpoints (parallel replay); the index
+already holds a copy, so the record keeps its own only when the engine asks for it (setId), and drops it on remove.
+
+The arrays are chunked (CHUNK records per allocation, a power of two so that a handle splits into chunk and slot with a shift):
+records never move (the level queues and the cold lists of the price band point to them), and the handles of removed orders
+are recycled, so the store stays as large as the peak number of live orders.
+*/
+
+struct OrderRecord
+{
+    std::string id; //a copy, empty unless set: the flat id indexes move their entries, their keys have no stable address
+    int originalSize;
+    long timestamp; //entry time
+};
+
+template <class T, size_t ChunkBits>
+class ChunkedArray
+{
+public:
+
+    static const size_t CHUNK = size_t(1) << ChunkBits;
+
+    ChunkedArray() : size_(0)
+    {   }
+
+    size_t size() const { return size_; }
+
+    void grow()
+    {
+        if (size_ == chunks_.size() * CHUNK)
+            chunks_.emplace_back(new T[CHUNK]);
+        ++size_;
+    }
+
+    T& operator[](const size_t index) { return chunks_[index >> ChunkBits][index & (CHUNK - 1)]; }
+    const T& operator[](const size_t index) const { return chunks_[index >> ChunkBits][index & (CHUNK - 1)]; }
+
+private:
+
+    std::vector<std::unique_ptr<T[]>> chunks_;
+    size_t size_;
+};
+
+class OrderStore
+{
+public:
+
+#ifdef BOOK_SPLIT_ORDERS
+    OrderInfo& hot(const uint32_t handle) { return hot_[handle]; }
+    const OrderInfo& hot(const uint32_t handle) const { return hot_[handle]; }
+    const OrderRecord& record(const uint32_t handle) const { return records_[handle]; }
+    size_t capacity() const { return hot_.size(); }
+#else
+    OrderInfo& hot(const uint32_t handle) { return orders_[handle].hot; }
+    const OrderInfo& hot(const uint32_t handle) const { return orders_[handle].hot; }
+    const OrderRecord& record(const uint32_t handle) const { return orders_[handle].record; }
+    size_t capacity() const { return orders_.size(); }
+#endif
+
+    //store a new order, its handle is filled in; its id is empty until setId
+    uint32_t add(const OrderInfo& order, const long timestamp)
+    {
+        uint32_t handle;
+        if (!free_.empty())
+        {
+            handle = free_.back();
+            free_.pop_back();
+        }
+        else
+        {
+            handle = static_cast<uint32_t>(capacity());
+            grow();
+        }
+
+        hot(handle) = order;
+        hot(handle).handle = handle;
+        coldRecord(handle).originalSize = order.size;
+        coldRecord(handle).timestamp = timestamp;
+        return handle;
+    }
+
+    void setId(const uint32_t handle, const std::string& id)
+    {
+        coldRecord(handle).id = id;
+    }
+
+    void remove(const uint32_t handle)
+    {
+        std::string().swap(coldRecord(handle).id); //release a long id now rather than when the handle is reused
+        free_.push_back(handle);
+    }
+
+    size_t live() const { return capacity() - free_.size(); }
+
+private:
+
+#ifdef BOOK_SPLIT_ORDERS
+    OrderRecord& coldRecord(const uint32_t handle) { return records_[handle]; }
+
+    void grow()
+    {
+        hot_.grow();
+        records_.grow();
+    }
+
+    ChunkedArray<OrderInfo, 12> hot_;
+    ChunkedArray<OrderRecord, 12> records_;
+#else
+    struct StoredOrder
+    {
+        OrderInfo hot;
+        OrderRecord record;
+    };
+
+    OrderRecord& coldRecord(const uint32_t handle) { return orders_[handle].record; }
+    void grow() { orders_.grow(); }
+
+    ChunkedArray<StoredOrder, 12> orders_;
+#endif
+    std::vector<uint32_t> free_;
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include "book_levels.h"
+#include "metrics.h"
+#include "trace.h"
+
+/*
+Buffered writer for the analyzer output lines:
+<timestamp> <side> <amount with 2 decimals>
+<timestamp> <side> NA
+optionally followed by the error bound of the approximate mode (see writeErrorBound), the venue split of a consolidated book
+(see writeVenueFill) and the top of book columns (see writeTop).
+Notional target lines, trade records and portfolio lines have their own formats (writeNotionalFill, writeTrade, writePortfolio).
+
+Lines are formatted by hand into a local buffer and handed to the stream in large chunks,
+instead of going through the stream formatting (and a flush) for every line.
+The amount is given in ticks together with the tick scale, when the scale is a compile time constant
+the conversion to hundredths is folded by the compiler.
+*/
+
+class OutputWriter
+{
+public:
+
+    explicit OutputWriter(std::ostream& out) : out_(out), used_(0)
+    {   }
+
+    ~OutputWriter()
+    {
+        flush();
+    }
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    //writer on std::cout, flushed at exit
+    static OutputWriter& standardOutput()
+    {
+        static OutputWriter writer(std::cout);
+        return writer;
+    }
+
+    void flush()
+    {
+        TRACE_SCOPE("output flush");
+        if (used_ > 0)
+            out_.write(buffer_, static_cast<std::streamsize>(used_));
+        used_ = 0;
+        out_.flush();
+    }
+
+    //a line is one of writeNA/writeAmount, optionally followed by writeVenueFill groups and writeTop, and then endLine
+
+    void writeNA(const long timestamp, const char side)
+    {
+        char* p = beginLine(timestamp, side);
+        *p++ = 'N';
+        *p++ = 'A';
+        used_ = static_cast<size_t>(p - buffer_);
+    }
+
+    template <class Scale>
+    void writeAmount(const long timestamp, const char side, const long long amount, const Scale scale)
+    {
+        char* p = beginLine(timestamp, side);
+        p = writeFixed<2>(p, toUnits<2>(amount, scale));
+        used_ = static_cast<size_t>(p - buffer_);
+    }
+
+    //notional target line: <timestamp> <side> <shares> <average price with 4 decimals>, NA price for 0 shares
+    template <class Scale>
+    void writeNotionalFill(const long timestamp, const char side, const long shares, const long long amount, const Scale scale)
+    {
+        char* p = beginLine(timestamp, side);
+        p = writeInt(p, shares);
+        *p++ = ' ';
+        if (shares > 0)
+        {
+            long long divisor = static_cast<long long>(scale) * shares; //amount is positive, rounded half up
+            p = writeFixed<4>(p, (amount * pow10(4) + divisor / 2) / divisor);
+        }
+        else
+            p = writeMissing(p);
+        used_ = static_cast<size_t>(p - buffer_);
+    }
+
+    //trade record: <timestamp> T <aggressor id> <resting id> <price> <size>
+    template <class Scale>
+    void writeTrade(const long timestamp, const std::string& aggressor, const std::string& resting, const Tick price, const int size,
+                    const Scale scale)
+    {
+        char* p = reserve(aggressor.size() + resting.size());
+        p = writeInt(p, timestamp);
+        *p++ = ' ';
+        *p++ = 'T';
+        *p++ = ' ';
+        p = std::copy(aggressor.begin(), aggressor.end(), p);
+        *p++ = ' ';
+        p = std::copy(resting.begin(), resting.end(), p);
+        *p++ = ' ';
+        p = writeFixed<2>(p, toUnits<2>(price, scale));
+        *p++ = ' ';
+        p = writeInt(p, size);
+        used_ = static_cast<size_t>(p - buffer_);
+    }
+
+    //portfolio line: <timestamp> <symbol> <value> <total>, NA for what is not available
+    template <class Scale>
+    void writePortfolio(const long timestamp, const std::string& symbol, const bool hasValue, const long long value,
+                        const bool hasTotal, const long long total, const Scale scale)
+    {
+        char* p = reserve(symbol.size());
+        p = writeInt(p, timestamp);
+        *p++ = ' ';
+        p = std::copy(symbol.begin(), symbol.end(), p);
+        *p++ = ' ';
+        p = hasValue ? writeFixed<2>(p, toUnits<2>(value, scale)) : writeMissing(p);
+        *p++ = ' ';
+        p = hasTotal ? writeFixed<2>(p, toUnits<2>(total, scale)) : writeMissing(p);
+        used_ = static_cast<size_t>(p - buffer_);
+    }
+
+    //error bound column of the approximate mode, 2 decimals rounded up so that the bound still holds
+    template <class Scale>
+    void writeErrorBound(const long long error, const Scale scale)
+    {
+        char* p = buffer_ + used_;
+        *p++ = ' ';
+        p = writeFixed<2>(p, (error * pow10(2) + scale - 1) / scale);
+        used_ = static_cast<size_t>(p - buffer_);
+    }
+
+    //venue split column group: v<venue> <shares> <amount with 2 decimals>
+    template <class Scale>
+    void writeVenueFill(const int venue, const long shares, const long long amount, const Scale scale)
+    {
+        char* p = reserve();
+        *p++ = ' ';
+        *p++ = 'v';
+        p = writeInt(p, venue);
+        *p++ = ' ';
+        p = writeInt(p, shares);
+        *p++ = ' ';
+        p = writeFixed<2>(p, toUnits<2>(amount, scale));
+        used_ = static_cast<size_t>(p - buffer_);
+    }
+
+    //top of book columns: bid, bid size, ask, ask size, spread, mid (NA for what is missing)
+    template <class Scale>
+    void writeTop(const TopOfBook& top, const Scale scale)
+    {
+        char* p = buffer_ + used_;
+
+        *p++ = ' ';
+        p = top.hasBid ? writeFixed<2>(p, toUnits<2>(top.bid, scale)) : writeMissing(p);
+        *p++ = ' ';
+        p = writeInt(p, top.bidSize);
+        *p++ = ' ';
+        p = top.hasAsk ? writeFixed<2>(p, toUnits<2>(top.ask, scale)) : writeMissing(p);
+        *p++ = ' ';
+        p = writeInt(p, top.askSize);
+        *p++ = ' ';
+        p = top.hasBid && top.hasAsk ? writeFixed<2>(p, toUnits<2>(top.spread(), scale)) : writeMissing(p);
+        *p++ = ' ';
+        //mid is on half ticks, printed with one more decimal
+        p = top.hasBid && top.hasAsk ? writeFixed<3>(p, toUnits<3>(top.bid + top.ask, 2 * scale)) : writeMissing(p);
+
+        used_ = static_cast<size_t>(p - buffer_);
+    }
+
+    void endLine()
+    {
+        buffer_[used_++] = '\n';
+        Metrics::count(Metric::LINES);
+    }
+
+private:
+
+    static const size_t BUFFER_SIZE = 1 << 16;
+    static const size_t MAX_LINE = 256;
+
+    static constexpr long long pow10(const int n)
+    {
+        return n == 0 ? 1 : 10 * pow10(n - 1);
+    }
+
+    //value in ticks to units of 10^-Decimals, rounding half away from zero
+    template <int Decimals, class Scale>
+    static long long toUnits(const long long value, const Scale scale)
+    {
+        const long long unit = pow10(Decimals);
+        if (scale == unit)
+            return value;
+        if (scale % unit == 0)
+        {
+            long long divisor = scale / unit;
+            return (value + (value < 0 ? -divisor / 2 : divisor / 2)) / divisor;
+        }
+        return value * unit / scale;
+    }
+
+    char* beginLine(const long timestamp, const char side)
+    {
+        char* p = reserve();
+        p = writeInt(p, timestamp);
+        *p++ = ' ';
+        *p++ = side;
+        *p++ = ' ';
+        return p;
+    }
+
+    template <int Decimals>
+    static char* writeFixed(char* p, long long units)
+    {
+        if (units < 0)
+        {
+            *p++ = '-';
+            units = -units;
+        }
+
+        p = writeInt(p, units / pow10(Decimals));
+        *p++ = '.';
+        for (long long divisor = pow10(Decimals - 1); divisor > 0; divisor /= 10)
+            *p++ = static_cast<char>('0' + units / divisor % 10);
+
+        return p;
+    }
+
+    static char* writeMissing(char* p)
+    {
+        *p++ = 'N';
+        *p++ = 'A';
+        return p;
+    }
+
+    //room for a line of MAX_LINE characters plus extra (ids, much shorter than the buffer)
+    char* reserve(const size_t extra = 0)
+    {
+        if (used_ + MAX_LINE + extra > BUFFER_SIZE)
+        {
+            TRACE_SCOPE("output flush");
+            out_.write(buffer_, static_cast<std::streamsize>(used_));
+            used_ = 0;
+        }
+        return buffer_ + used_;
+    }
+
+    static char* writeInt(char* p, long long value)
+    {
+        if (value < 0)
+        {
+            *p++ = '-';
+            value = -value;
+        }
+
+        char digits[24];
+        int n = 0;
+        do
+        {
+            digits[n++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+
+        while (n > 0)
+            *p++ = digits[--n];
+
+        return p;
+    }
+
+    std::ostream& out_;
+    size_t used_;
+    char buffer_[BUFFER_SIZE];
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "book_levels.h"
+#include "feed_event.h"
+#include "metrics.h"
+#include "output_writer.h"
+#include "trace.h"
+
+/*
+Parallel replay of one text feed (--parallel K): the lines printed depend only on the book after every event
+(see BookAnalyzer::resync), so the feed can be cut into K segments replayed at the same time once the book at the start
+of each segment is known.
+
+The file is cut at K evenly spaced byte offsets (moved forward to the next line). A pre-pass replays the feed with the target
+evaluation off (evaluate_ false, no walk and no line, only the level and order updates) and, when it reaches the start
+of a segment, takes a checkpoint of its book and starts the thread of that segment. The thread rebuilds the book from the
+checkpoint, resyncs the amounts last printed and replays its segment with full output into its own buffer; the buffers are
+written out in segment order. The first segment starts right away from an empty book, the pre-pass stops at the start of
+the last one.
+
+A checkpoint is the book written as events: the resting orders as adds (level by level, each level in time priority,
+with their remaining size) and the levels fed by level updates as level updates. Restoring it costs one add per live order,
+not a replay of everything before the segment, and the engines need not be copyable.
+
+With K cores the pre-pass (parse and book updates) is the serial part, the walks and the output are spread over the segments.
+Not supported: the price band (cold orders), matching (trade records of the pre-pass), approximate and consolidated books.
+The event counters of the metrics include the events of the pre-pass. The metrics dumps (SIGUSR1, periodic) are polled by
+the pre-pass between its events, with the gauges of its book; a dump asked for after the pre-pass is taken at the end,
+with the book of the last segment.
+*/
+
+//events that rebuild the book of bookAnalyzer in an empty one, see restoreCheckpoint
+template <class Analyzer>
+std::vector<FeedEvent> takeCheckpoint(const Analyzer& bookAnalyzer)
+{
+    std::vector<FeedEvent> events;
+    for (const Side side : {Side::BUY, Side::SELL})
+    {
+        (side == Side::BUY ? bookAnalyzer.buyMap_ : bookAnalyzer.sellMap_).forEach([&](const Tick key, const Level& level)
+        {
+            FeedEvent event;
+            event.side = side;
+            event.price = bookAnalyzer.tickToPrice(keyToTick(key, side));
+            if (level.queue.empty())
+            {
+                event.type = 'L';
+                event.timestamp = 0;
+                event.size = static_cast<int>(level.size);
+                events.push_back(event);
+                return true;
+            }
+
+            event.type = 'A';
+            level.queue.forEach([&](const OrderInfo* order)
+            {
+                const OrderRecord& record = bookAnalyzer.orders_.record(order->handle);
+                event.timestamp = record.timestamp;
+                event.id = record.id;
+                event.size = order->size;
+                event.venue = order->venue;
+                events.push_back(event);
+                return true;
+            });
+            return true;
+        });
+    }
+    return events;
+}
+
+//rebuild a checkpoint in the empty book of bookAnalyzer and resync its amounts, nothing is printed
+template <class Analyzer>
+void restoreCheckpoint(Analyzer& bookAnalyzer, const std::vector<FeedEvent>& events)
+{
+    const bool evaluate[2] = {bookAnalyzer.evaluate_[Side::BUY], bookAnalyzer.evaluate_[Side::SELL]};
+    bookAnalyzer.evaluate_[Side::BUY] = bookAnalyzer.evaluate_[Side::SELL] = false;
+
+    for (const FeedEvent& event : events)
+    {
+        if (event.type == 'A')
+            bookAnalyzer.handleNewOrder(event.id, event.side, event.size, event.price, event.timestamp, static_cast<uint8_t>(event.venue));
+        else
+            bookAnalyzer.setLevel(event.side, event.size, event.price, event.timestamp);
+    }
+
+    bookAnalyzer.evaluate_[Side::BUY] = evaluate[Side::BUY];
+    bookAnalyzer.evaluate_[Side::SELL] = evaluate[Side::SELL];
+    bookAnalyzer.resync();
+}
+
+/*
+make(out) returns a new analyzer (std::unique_ptr) writing its lines to out, set up as for a serial replay;
+it is called once for the pre-pass and once per segment, from the threads of the segments too.
+poll(analyzer) is called with the book of the pre-pass after each of its events, finish(analyzer) with the book
+at the end of the feed once every segment is done, both on the calling thread.
+The output goes to out in feed order; false if the file cannot be read.
+*/
+template <class Make, class Poll, class Finish>
+bool replayParallel(const std::string& file, const size_t segments, Make&& make, std::ostream& out, Poll&& poll, Finish&& finish)
+{
+    typedef decltype(make(std::declval<OutputWriter&>())) Book;
+
+    std::ifstream infile(file, std::ios::binary);
+    if (!infile)
+        return false;
+
+    //segment starts, at line starts; the last entry is the end of the file
+    infile.seekg(0, std::ios::end);
+    const std::streamoff size = infile.tellg();
+    std::vector<std::streamoff> starts(1, 0);
+    std::string line;
+    for (size_t k = 1; k < segments; ++k)
+    {
+        std::streamoff offset = std::max(size * static_cast<std::streamoff>(k) / static_cast<std::streamoff>(segments), starts.back());
+        infile.clear();
+        infile.seekg(offset > 0 ? offset - 1 : 0); //a cut right after a newline stays there
+        std::getline(infile, line);
+        offset = infile ? static_cast<std::streamoff>(infile.tellg()) : size;
+        if (offset > starts.back() && offset < size)
+            starts.push_back(offset);
+    }
+    starts.push_back(size);
+
+    struct Segment
+    {
+        std::streamoff begin = 0;
+        std::streamoff end = 0;
+        std::vector<FeedEvent> checkpoint;
+        std::ostringstream out;
+        std::unique_ptr<OutputWriter> writer;
+        Book bookAnalyzer; //kept after the replay for the book at the end of the feed
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Segment>> parts;
+    for (size_t k = 0; k + 1 < starts.size(); ++k)
+    {
+        parts.emplace_back(new Segment());
+        parts.back()->begin = starts[k];
+        parts.back()->end = starts[k + 1];
+    }
+
+    auto replaySegment = [&file, &make](Segment& segment)
+    {
+        TRACE_THREAD_NAME("segment");
+        TRACE_SCOPE("replay segment");
+        segment.writer.reset(new OutputWriter(segment.out));
+        segment.bookAnalyzer = make(*segment.writer);
+        auto& bookAnalyzer = segment.bookAnalyzer;
+        restoreCheckpoint(*bookAnalyzer, segment.checkpoint);
+        segment.checkpoint.clear();
+
+        std::ifstream input(file, std::ios::binary);
+        input.seekg(segment.begin);
+        std::string text;
+        FeedEvent event;
+        for (std::streamoff position = segment.begin; position < segment.end && std::getline(input, text); )
+        {
+            position += static_cast<std::streamoff>(text.size()) + 1;
+            Metrics::count(Metric::BYTES_READ, text.size() + 1);
+            if (!parseFeedEvent(text, event))
+                break;
+            applyFeedEvent(*bookAnalyzer, event);
+        }
+        segment.writer->flush();
+    };
+
+    parts[0]->thread = std::thread(replaySegment, std::ref(*parts[0]));
+
+    //pre-pass up to the start of the last segment
+    {
+        TRACE_SCOPE("pre-pass");
+        std::ostringstream none;
+        OutputWriter silent(none);
+        auto bookAnalyzer = make(silent);
+        bookAnalyzer->printLines_ = false;
+        bookAnalyzer->keepIds_ = true;
+        bookAnalyzer->evaluate_[Side::BUY] = bookAnalyzer->evaluate_[Side::SELL] = false;
+
+        infile.clear();
+        infile.seekg(0);
+        std::streamoff position = 0;
+        FeedEvent event;
+        for (size_t k = 1; k < parts.size(); ++k)
+        {
+            bool more = true;
+            while (position < parts[k]->begin && (more = static_cast<bool>(std::getline(infile, line))))
+            {
+                position += static_cast<std::streamoff>(line.size()) + 1;
+                if (!(more = parseFeedEvent(line, event)))
+                    break;
+                applyFeedEvent(*bookAnalyzer, event);
+                poll(*bookAnalyzer);
+            }
+            if (!more)
+            {
+                parts.resize(k); //the feed ended before this segment, the segment before it stops there too
+                break;
+            }
+
+            parts[k]->checkpoint = takeCheckpoint(*bookAnalyzer);
+            parts[k]->thread = std::thread(replaySegment, std::ref(*parts[k]));
+        }
+    }
+
+    for (std::unique_ptr<Segment>& segment : parts)
+    {
+        segment->thread.join();
+        out << segment->out.str();
+        if (segment != parts.back())
+            segment->bookAnalyzer.reset();
+    }
+    out.flush();
+    finish(*parts.back()->bookAnalyzer);
+    return true;
+}
@@ -0,0 +1,456 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "trace.h"
+
+/*
+Replay of UDP market data from pcap captures, classic (microsecond or nanosecond) and pcapng, in either byte order.
+
+The capture is mapped in memory and walked in place: for every packet the link layer (Ethernet with any number of VLAN tags,
+Linux cooked capture or raw IP), the IPv4/IPv6 header and the UDP header are stripped, and the UDP payload is handed
+to the payload decoder when its destination port matches (port 0 takes every UDP packet).
+IP fragments, non UDP packets and packets cut short by the capture snap length are counted and skipped.
+
+The payload decoder is any callable taking (const uint8_t* payload, size_t length);
+MoldUdp64Payload unwraps the MoldUDP64 framing of NASDAQ multicast feeds for a message decoder such as ItchDecoder.
+
+Packets are replayed at full speed, or following the capture timestamps: with speed 1 the gaps between packets are those
+of the capture, with speed 2 they are halved, and so on.
+*/
+
+struct PcapStats
+{
+    long packets = 0;
+    long delivered = 0;  //UDP payloads handed to the decoder
+    long otherPort = 0;
+    long notUdp = 0;     //non IP, non UDP, fragments
+    long truncated = 0;
+};
+
+class PcapReader
+{
+public:
+
+    PcapReader() : data_(nullptr), size_(0)
+    {   }
+
+    ~PcapReader()
+    {
+        close();
+    }
+
+    PcapReader(const PcapReader&) = delete;
+    PcapReader& operator=(const PcapReader&) = delete;
+
+    //map the capture, false if it cannot be read or is not a pcap/pcapng file
+    bool open(const std::string& file)
+    {
+        close();
+
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                data_ = static_cast<const uint8_t*>(data);
+                size_ = static_cast<size_t>(st.st_size);
+                ::madvise(data, size_, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+
+        return data_ != nullptr && (isPcapNg() || isClassic());
+    }
+
+    void close()
+    {
+        if (data_ != nullptr)
+            ::munmap(const_cast<uint8_t*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const PcapStats& stats() const { return stats_; }
+
+    //hand the UDP payloads sent to port (0 for any) to decoder, at full speed (speed 0) or following the capture timing
+    template <class Decoder>
+    void replay(const uint16_t port, Decoder&& decoder, const double speed = 0)
+    {
+        bool first = true;
+        uint64_t firstTimestamp = 0;
+        std::chrono::steady_clock::time_point start;
+
+        forEachPacket([&](const uint64_t timestamp, const uint32_t linkType, const uint8_t* frame, const size_t length, const bool complete)
+        {
+            ++stats_.packets;
+            Metrics::count(Metric::BYTES_READ, length);
+            if (!complete)
+            {
+                ++stats_.truncated;
+                return;
+            }
+
+            const uint8_t* payload;
+            size_t payloadLength;
+            uint16_t destination;
+            if (!udpPayload(linkType, frame, length, payload, payloadLength, destination))
+            {
+                ++stats_.notUdp;
+                return;
+            }
+            if (port != 0 && destination != port)
+            {
+                ++stats_.otherPort;
+                return;
+            }
+
+            if (speed > 0)
+            {
+                if (first)
+                {
+                    first = false;
+                    firstTimestamp = timestamp;
+                    start = std::chrono::steady_clock::now();
+                }
+                if (timestamp > firstTimestamp)
+                {
+                    auto offset = std::chrono::nanoseconds(static_cast<long long>((timestamp - firstTimestamp) / speed));
+                    std::this_thread::sleep_until(start + offset);
+                }
+            }
+
+            ++stats_.delivered;
+            TRACE_SAMPLED_SCOPE("decode packet");
+            decoder(payload, payloadLength);
+        });
+    }
+
+    //visit every packet: f(timestamp in ns, link type, frame, captured length, whether the whole packet was captured)
+    template <class F>
+    void forEachPacket(F&& f) const
+    {
+        if (isPcapNg())
+            forEachPcapNg(f);
+        else if (isClassic())
+            forEachClassic(f);
+    }
+
+private:
+
+    static const uint32_t LINK_ETHERNET = 1;
+    static const uint32_t LINK_RAW = 101;
+    static const uint32_t LINK_LINUX_SLL = 113;
+    static const uint32_t PCAPNG_SECTION = 0x0a0d0d0a;
+    static const size_t MAX_INTERFACES = 16;
+
+    static uint16_t swap(const uint16_t value) { return __builtin_bswap16(value); }
+    static uint32_t swap(const uint32_t value) { return __builtin_bswap32(value); }
+
+    //capture header fields are in the byte order of the writer
+    uint32_t read32(const size_t pos, const bool swapped) const
+    {
+        uint32_t value;
+        std::memcpy(&value, data_ + pos, sizeof(value));
+        return swapped ? swap(value) : value;
+    }
+
+    uint16_t read16(const size_t pos, const bool swapped) const
+    {
+        uint16_t value;
+        std::memcpy(&value, data_ + pos, sizeof(value));
+        return swapped ? swap(value) : value;
+    }
+
+    //network headers are big-endian
+    static uint16_t readBE16(const uint8_t* p)
+    {
+        return static_cast<uint16_t>(p[0] << 8 | p[1]);
+    }
+
+    bool isClassic() const
+    {
+        if (size_ < 24)
+            return false;
+        uint32_t magic = read32(0, false);
+        return magic == 0xa1b2c3d4 || magic == 0xa1b23c4d || magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+    }
+
+    bool isPcapNg() const
+    {
+        return size_ >= 12 && read32(0, false) == PCAPNG_SECTION;
+    }
+
+    template <class F>
+    void forEachClassic(F& f) const
+    {
+        uint32_t magic = read32(0, false);
+        bool swapped = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+        bool nanoseconds = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+        uint32_t linkType = read32(20, swapped) & 0xffff;
+
+        for (size_t pos = 24; pos + 16 <= size_;)
+        {
+            uint64_t seconds = read32(pos, swapped);
+            uint64_t fraction = read32(pos + 4, swapped);
+            size_t captured = read32(pos + 8, swapped);
+            size_t original = read32(pos + 12, swapped);
+            pos += 16;
+            if (pos + captured > size_)
+                break;
+
+            f(seconds * 1000000000 + (nanoseconds ? fraction : fraction * 1000), linkType, data_ + pos, captured, captured >= original);
+            pos += captured;
+        }
+    }
+
+    template <class F>
+    void forEachPcapNg(F& f) const
+    {
+        bool swapped = false;
+        size_t interfaces = 0;
+        uint32_t linkTypes[MAX_INTERFACES];
+        uint64_t unitsPerSecond[MAX_INTERFACES];
+
+        for (size_t pos = 0; pos + 12 <= size_;)
+        {
+            if (read32(pos, false) == PCAPNG_SECTION)
+            {
+                //a new section restarts the byte order and the interface list
+                swapped = read32(pos + 8, false) != 0x1a2b3c4d;
+                interfaces = 0;
+            }
+
+            uint32_t type = read32(pos, swapped);
+            size_t length = read32(pos + 4, swapped);
+            if (length < 12 || pos + length > size_)
+                break;
+
+            if (type == 1 && interfaces < MAX_INTERFACES && length >= 20) //interface description
+            {
+                linkTypes[interfaces] = read16(pos + 8, swapped);
+                unitsPerSecond[interfaces] = timestampUnits(pos + 16, pos + length - 4, swapped);
+                ++interfaces;
+            }
+            else if (type == 6 && length >= 32) //enhanced packet
+            {
+                uint32_t interface = read32(pos + 8, swapped);
+                uint64_t units = uint64_t(read32(pos + 12, swapped)) << 32 | read32(pos + 16, swapped);
+                size_t captured = read32(pos + 20, swapped);
+                size_t original = read32(pos + 24, swapped);
+
+                //the packet data (padded to 4 bytes) must end before the options and the trailing block length
+                if (interface < interfaces && captured <= length - 32 && 28 + ((captured + 3) & ~size_t(3)) + 4 <= length)
+                    f(nanoseconds(units, unitsPerSecond[interface]), linkTypes[interface], data_ + pos + 28, captured, captured >= original);
+            }
+            else if (type == 3 && length >= 16 && interfaces > 0) //simple packet, no timestamp
+            {
+                size_t original = read32(pos + 8, swapped);
+                size_t captured = std::min(original, length - 16);
+                f(uint64_t(0), linkTypes[0], data_ + pos + 12, captured, captured >= original);
+            }
+
+            pos += length;
+        }
+    }
+
+    //timestamp in units of 1/perSecond seconds to nanoseconds, without overflow for any if_tsresol
+    static uint64_t nanoseconds(const uint64_t units, const uint64_t perSecond)
+    {
+        uint64_t seconds = units / perSecond;
+        uint64_t fraction = units % perSecond;
+        if (perSecond <= 1000000000)
+            return seconds * 1000000000 + fraction * 1000000000 / perSecond; //fraction * 10^9 < 10^18
+
+        //finer than a nanosecond: one decimal digit at a time, dividing before the next multiplication
+        //(fraction < perSecond <= 2^60, so fraction * 10 fits)
+        uint64_t nanos = 0;
+        for (int digit = 0; digit < 9; ++digit)
+        {
+            fraction *= 10;
+            nanos = nanos * 10 + fraction / perSecond;
+            fraction %= perSecond;
+        }
+        return seconds * 1000000000 + nanos;
+    }
+
+    //if_tsresol option of an interface description block, microseconds by default
+    uint64_t timestampUnits(size_t pos, const size_t end, const bool swapped) const
+    {
+        while (pos + 4 <= end)
+        {
+            uint16_t code = read16(pos, swapped);
+            uint16_t length = read16(pos + 2, swapped);
+            if (code == 0)
+                break;
+            if (code == 9 && length >= 1 && pos + 5 <= end)
+            {
+                uint8_t resolution = data_[pos + 4];
+                uint64_t units = 1;
+                for (int i = 0; i < (resolution & 0x7f) && units < 1000000000000000000ull; ++i)
+                    units *= resolution & 0x80 ? 2 : 10;
+                return units;
+            }
+            pos += 4 + ((length + 3u) & ~3u);
+        }
+        return 1000000;
+    }
+
+    static bool udpPayload(const uint32_t linkType, const uint8_t* frame, const size_t length,
+                           const uint8_t*& payload, size_t& payloadLength, uint16_t& destination)
+    {
+        size_t pos;
+        uint16_t etherType;
+
+        if (linkType == LINK_ETHERNET)
+        {
+            pos = 12;
+            if (length < pos + 2)
+                return false;
+            etherType = readBE16(frame + pos);
+            //802.1Q / 802.1ad tags
+            while ((etherType == 0x8100 || etherType == 0x88a8) && length >= pos + 6)
+            {
+                pos += 4;
+                etherType = readBE16(frame + pos);
+            }
+            pos += 2;
+        }
+        else if (linkType == LINK_LINUX_SLL)
+        {
+            if (length < 16)
+                return false;
+            etherType = readBE16(frame + 14);
+            pos = 16;
+        }
+        else if (linkType == LINK_RAW)
+        {
+            if (length < 1)
+                return false;
+            etherType = (frame[0] >> 4) == 6 ? 0x86dd : 0x0800;
+            pos = 0;
+        }
+        else
+        {
+            return false;
+        }
+
+        size_t end = length;
+        if (etherType == 0x0800) //IPv4
+        {
+            if (length < pos + 20 || (frame[pos] >> 4) != 4 || frame[pos + 9] != 17)
+                return false;
+            if ((readBE16(frame + pos + 6) & 0x3fff) != 0) //more fragments or fragment offset
+                return false;
+
+            end = std::min(end, pos + readBE16(frame + pos + 2));
+            pos += (frame[pos] & 0x0f) * 4u;
+        }
+        else if (etherType == 0x86dd) //IPv6, without extension headers
+        {
+            if (length < pos + 40 || frame[pos + 6] != 17)
+                return false;
+
+            end = std::min(end, pos + 40 + readBE16(frame + pos + 4));
+            pos += 40;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (end < pos + 8)
+            return false;
+
+        destination = readBE16(frame + pos + 2);
+        end = std::min(end, pos + readBE16(frame + pos + 4));
+        if (end < pos + 8)
+            return false;
+
+        payload = frame + pos + 8;
+        payloadLength = end - pos - 8;
+        return true;
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    PcapStats stats_;
+};
+
+//MoldUDP64 packet: session (10), sequence number (8), message count (2), then length prefixed messages;
+//the messages are handed to a decoder with decodeStream (ItchDecoder).
+//Packets already seen (retransmissions, the second line of an A/B pair) are dropped, the messages already seen of a packet
+//that overlaps the ones before are skipped, sequence gaps are counted
+template <class Decoder>
+class MoldUdp64Payload
+{
+public:
+
+    explicit MoldUdp64Payload(Decoder& decoder) : decoder_(decoder), nextSequence_(0), gaps_(0), duplicates_(0)
+    {   }
+
+    long gaps() const { return gaps_; }
+    long duplicates() const { return duplicates_; }
+
+    void operator()(const uint8_t* payload, const size_t length)
+    {
+        if (length < HEADER_LENGTH)
+            return;
+
+        uint64_t sequence = 0;
+        for (int i = 10; i < 18; ++i)
+            sequence = sequence << 8 | payload[i];
+        uint16_t count = static_cast<uint16_t>(payload[18] << 8 | payload[19]);
+
+        if (count == 0 || count == 0xffff) //heartbeat or end of session
+            return;
+        if (nextSequence_ != 0 && sequence + count <= nextSequence_)
+        {
+            ++duplicates_;
+            return;
+        }
+
+        //a packet overlapping what was already seen (a retransmission with a different packing) skips the messages seen
+        size_t pos = HEADER_LENGTH;
+        if (nextSequence_ != 0 && sequence < nextSequence_)
+        {
+            for (uint64_t seen = nextSequence_ - sequence; seen > 0 && pos + 2 <= length; --seen)
+                pos += 2 + static_cast<size_t>(payload[pos] << 8 | payload[pos + 1]);
+            if (pos > length)
+                return;
+        }
+        else if (nextSequence_ != 0 && sequence > nextSequence_)
+        {
+            ++gaps_;
+        }
+        nextSequence_ = sequence + count;
+
+        decoder_.decodeStream(payload + pos, length - pos);
+    }
+
+private:
+
+    static const size_t HEADER_LENGTH = 20;
+
+    Decoder& decoder_;
+    uint64_t nextSequence_;
+    long gaps_;
+    long duplicates_;
+};
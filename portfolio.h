@@ -0,0 +1,116 @@
+#pragma once
+
+#include <climits>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "book_analyzer.h"
+#include "feed_event.h"
+
+/*
+Portfolio liquidation: the cash obtained by unwinding every position against its own book, and the portfolio total.
+
+Each instrument has its own book (BookAnalyzer) with the size of the position as target, evaluated on one side only:
+a long position is sold into the bids, a short one is bought from the asks. The books do not print anything;
+after every event the portfolio reads the amount kept by the book of that instrument and, when it changed,
+updates the total incrementally (the old value out, the new one in) and prints
+<timestamp> <symbol> <value> <total>
+value is the cash of the unwind, positive (income) for a long position and negative (expenses) for a short one,
+NA while the book cannot fill the position; the total is NA while any position cannot be unwound in full.
+
+A book only walks its levels when the change is inside the region of its previous fill (see BookAnalyzer::printTarget),
+so the events of a book away from its touch cost the level update only, and the other books are not touched at all.
+*/
+
+template <class Levels = MapLevels, class Index = StdOrderIndex>
+class Portfolio
+{
+public:
+
+    typedef BookAnalyzer<Levels, RuntimeParams, Index> Book;
+
+    explicit Portfolio(OutputWriter& out = OutputWriter::standardOutput(), const long tickScale = TICK_SCALE) :
+        tickScale_(tickScale), total_(0), unavailable_(0), out_(out)
+    {   }
+
+    //the size of a position is the target of its book, an int
+    static const long MAX_POSITION = INT_MAX;
+
+    //position > 0 is long, < 0 is short, at most MAX_POSITION shares either way;
+    //returns the index of the instrument, the feed tag of its events
+    size_t addInstrument(const std::string& symbol, const long position)
+    {
+        std::unique_ptr<Instrument> instrument(new Instrument(symbol, position, tickScale_, out_));
+        instruments_.push_back(std::move(instrument));
+        ++unavailable_;
+        return instruments_.size() - 1;
+    }
+
+    size_t size() const { return instruments_.size(); }
+
+    Book& book(const size_t index) { return instruments_[index]->book; }
+
+    //apply one event to the book of the instrument index
+    void apply(const size_t index, const FeedEvent& event)
+    {
+        Instrument& instrument = *instruments_[index];
+        applyFeedEvent(instrument.book, event);
+        update(instrument, event.timestamp);
+    }
+
+    bool complete() const { return unavailable_ == 0; }
+    long long total() const { return total_; } //in ticks
+
+private:
+
+    struct Instrument
+    {
+        Instrument(const std::string& symbol, const long position, const long tickScale, OutputWriter& out) :
+            symbol(symbol), side(position > 0 ? Side::BUY : Side::SELL),
+            book(RuntimeParams(static_cast<int>(std::labs(position)), tickScale), out), available(false), value(0)
+        {
+            book.printLines_ = false;
+            book.evaluate_[side == Side::BUY ? Side::SELL : Side::BUY] = false;
+        }
+
+        std::string symbol;
+        Side side; //the side of the book the position is unwound into
+        Book book;
+        bool available;
+        long long value;
+    };
+
+    void update(Instrument& instrument, const long timestamp)
+    {
+        const Book& book = instrument.book;
+        bool available = instrument.side == Side::BUY ? !book.prevNanExp_ : !book.prevNanIncome_;
+        long long value = instrument.side == Side::BUY ? book.prevExpenses_ : -book.prevIncome_;
+
+        if (available == instrument.available && (!available || value == instrument.value))
+            return;
+
+        if (instrument.available)
+            total_ -= instrument.value;
+        else
+            --unavailable_;
+
+        if (available)
+            total_ += value;
+        else
+            ++unavailable_;
+
+        instrument.available = available;
+        instrument.value = value;
+
+        out_.writePortfolio(timestamp, instrument.symbol, available, value, unavailable_ == 0, total_, tickScale_);
+        out_.endLine();
+    }
+
+    std::vector<std::unique_ptr<Instrument>> instruments_;
+    long tickScale_;
+    long long total_;
+    size_t unavailable_;
+    OutputWriter& out_;
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "book_levels.h"
+#include "occupancy_bitmap.h"
+
+/*
+Tick indexed price ladder that follows the touch.
+
+The ladder keeps a window of Width consecutive keys [lo_, lo_+Width) in a ring of slots, slot = key & (Width-1),
+so that find/insert/erase of a level close to the best price is a plain array access.
+Levels that fall outside the window (far from the touch) are spilled into an ordered Overflow container.
+
+Since keys are ordered best-first (see book_levels.h), nothing is ever stored below lo_:
+- when a new level arrives that is better than lo_, the window is moved down so that the new best sits at
+  Width/4 from the bottom, levels pushed out of the top of the window are spilled to the overflow;
+- when the best drifts away and reaches the middle of the window, the window is moved up the same way,
+  and the overflow levels that come into range are pulled back into their slots.
+
+Moving the window only touches the slots that change owner (never more than Width of them),
+the ring offset takes care of the rest.
+
+Occupied slots are tracked in a hierarchical bitmap (occupancy_bitmap.h): when the best level empties,
+the next best is found with a few count-trailing-zeros whatever the gap, and the target walk and the spills
+jump from one occupied slot to the next instead of scanning the empty ones.
+*/
+
+struct LadderStats
+{
+    long recenters = 0;     //window moves
+    long spilled = 0;       //levels moved from the window to the overflow
+    long pulled = 0;        //levels moved from the overflow back into the window
+    long windowHits = 0;    //find/insert/erase served by the window
+    long overflowHits = 0;  //find/insert/erase that went to the overflow
+};
+
+template <size_t Width = 1024, class Overflow = MapLevels>
+class PriceLadder
+{
+    static_assert(Width >= 16 && (Width & (Width - 1)) == 0, "ladder width must be a power of 2");
+
+public:
+
+    PriceLadder() : slots_(Width), lo_(0), best_(0), count_(0)
+    {   }
+
+    Level* find(const Tick key)
+    {
+        if (inWindow(key))
+        {
+            ++stats_.windowHits;
+            size_t slot = slotOf(key);
+            return used_.test(slot) ? &slots_[slot] : nullptr;
+        }
+
+        if (key < lo_ || overflow_.empty())
+            return nullptr;
+
+        ++stats_.overflowHits;
+        return overflow_.find(key);
+    }
+
+    //return the level for key, creating an empty one if it doesn't exist
+    Level& insert(const Tick key)
+    {
+        if (count_ == 0)
+        {
+            //empty window: anchor it on the best level we are going to hold
+            Tick best = overflow_.empty() ? key : std::min(key, overflow_.bestKey());
+            moveWindow(best - Width / 4);
+        }
+        else if (key < lo_)
+        {
+            moveWindow(key - Width / 4);
+        }
+
+        if (!inWindow(key))
+        {
+            ++stats_.overflowHits;
+            return overflow_.insert(key);
+        }
+
+        ++stats_.windowHits;
+        size_t slot = slotOf(key);
+        if (!used_.test(slot))
+            occupy(key, slot);
+
+        return slots_[slot];
+    }
+
+    void erase(const Tick key)
+    {
+        if (!inWindow(key))
+        {
+            ++stats_.overflowHits;
+            overflow_.erase(key);
+            return;
+        }
+
+        ++stats_.windowHits;
+        size_t slot = slotOf(key);
+        if (!used_.test(slot))
+            return;
+
+        release(slot);
+
+        if (count_ == 0)
+        {
+            if (!overflow_.empty())
+                moveWindow(overflow_.bestKey() - Width / 4);
+            return;
+        }
+
+        if (key == best_)
+        {
+            best_ = nextKey(best_);
+
+            if (best_ >= lo_ + static_cast<Tick>(Width / 2))
+                moveWindow(best_ - Width / 4);
+        }
+    }
+
+    bool empty() const { return count_ == 0 && overflow_.empty(); }
+    size_t size() const { return count_ + overflow_.size(); }
+
+    //the best level is always in the window when the ladder is not empty
+    Tick bestKey() const { return best_; }
+
+    //visit levels best-first until f(key, level) returns false
+    template <class F>
+    void forEach(F&& f) const
+    {
+        size_t remaining = count_;
+        for (Tick key = best_; remaining > 0; key = nextKey(key + 1))
+        {
+            if (!f(key, static_cast<const Level&>(slots_[slotOf(key)])))
+                return;
+
+            --remaining;
+        }
+
+        overflow_.forEach(f);
+    }
+
+    const LadderStats& stats() const { return stats_; }
+    const Overflow& overflow() const { return overflow_; }
+
+private:
+
+    bool inWindow(const Tick key) const
+    {
+        return key >= lo_ && key < lo_ + static_cast<Tick>(Width);
+    }
+
+    static size_t slotOf(const Tick key)
+    {
+        return static_cast<size_t>(key) & (Width - 1);
+    }
+
+    //first occupied key >= key, the window must hold one
+    Tick nextKey(const Tick key) const
+    {
+        size_t slot = slotOf(key);
+        return key + static_cast<Tick>((used_.nextSetCircular(slot) - slot) & (Width - 1));
+    }
+
+    void occupy(const Tick key, const size_t slot)
+    {
+        used_.set(slot);
+        if (count_++ == 0 || key < best_)
+            best_ = key;
+    }
+
+    void release(const size_t slot)
+    {
+        used_.clear(slot);
+        slots_[slot].clear();
+        --count_;
+    }
+
+    //move the window to [newLo, newLo+Width): spill what falls off the top, pull in what comes into range
+    void moveWindow(const Tick newLo)
+    {
+        const Tick width = static_cast<Tick>(Width);
+
+        if (!empty())
+            ++stats_.recenters;
+
+        if (count_ > 0)
+        {
+            //moving down: keys in [newLo+Width, lo_+Width) leave the window
+            //moving up: keys in [lo_, newLo) leave the window but they are empty, since newLo is below the best
+            for (Tick key = std::max(newLo + width, lo_); count_ > 0; ++key)
+            {
+                key = nextKey(key);
+                if (key >= lo_ + width)
+                    break;
+
+                size_t slot = slotOf(key);
+                overflow_.insert(key, std::move(slots_[slot]));
+                slots_[slot] = Level();
+                release(slot);
+                ++stats_.spilled;
+            }
+        }
+
+        lo_ = newLo;
+
+        while (!overflow_.empty() && overflow_.bestKey() < lo_ + width)
+        {
+            Tick key = overflow_.bestKey();
+            size_t slot = slotOf(key);
+            slots_[slot] = overflow_.popBest();
+            occupy(key, slot);
+            ++stats_.pulled;
+        }
+    }
+
+    std::vector<Level> slots_;
+    OccupancyBitmap<Width> used_;
+    Tick lo_;
+    Tick best_;
+    size_t count_;
+    Overflow overflow_;
+    LadderStats stats_;
+};
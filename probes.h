@@ -0,0 +1,43 @@
+#pragma once
+
+/*
+Static probe points (USDT) of the engine, for attaching bpftrace or perf to a running analyzer without rebuilding it.
+
+When <sys/sdt.h> is available (systemtap-sdt-dev), BOOK_PROBEn(name, args...) leaves a single nop in the code
+and a note in the .note.stapsdt section telling the tracers where the nop is and where its arguments live.
+The arguments are still evaluated at the probe, attached or not, so that they are in a register or a stack slot when
+a tracer reads them: every probe below only passes values the code has at hand anyway (no call, no walk), which costs
+at most a spill, and none needs a semaphore guard (*_ENABLED()). A probe with an argument worth computing only for
+a tracer must be declared with a semaphore and guarded by it.
+Without the header, or when built with -DBOOK_NO_PROBES, the probes expand to nothing.
+
+Probes of the provider book_analyzer (side is the Side of the book, 0 buy and 1 sell, amounts are in ticks):
+  add        timestamp, side, size, tick      new order (handleNewOrder)
+  reduce     timestamp, side, size            reduction of an order (reduceOrder)
+  modify     timestamp, side, size, tick      modify or replace of an order (modifyOrder, replaceOrder), new size and price
+  level      timestamp, side, size, tick      market-by-price level update (setLevel)
+  walk_start timestamp, side                  target walk of a side
+  walk_end   timestamp, side, levels, filled  end of the walk: levels scanned (buckets in approximate mode), shares filled
+  print      timestamp, side, amount          amount line written
+  print_na   timestamp, side                  NA line written
+
+List them with `readelf -n book_analyzer` or `bpftrace -l 'usdt:./book_analyzer:*'`,
+tools/book_probes.bt computes latency distributions from them.
+*/
+
+#if !defined(BOOK_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define BOOK_PROBES 1
+#endif
+#endif
+
+#ifdef BOOK_PROBES
+#define BOOK_PROBE2(name, a, b) DTRACE_PROBE2(book_analyzer, name, a, b)
+#define BOOK_PROBE3(name, a, b, c) DTRACE_PROBE3(book_analyzer, name, a, b, c)
+#define BOOK_PROBE4(name, a, b, c, d) DTRACE_PROBE4(book_analyzer, name, a, b, c, d)
+#else
+#define BOOK_PROBE2(name, a, b) ((void)0)
+#define BOOK_PROBE3(name, a, b, c) ((void)0)
+#define BOOK_PROBE4(name, a, b, c, d) ((void)0)
+#endif
@@ -0,0 +1,514 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "book_levels.h"
+#include "feed_event.h"
+
+/*
+Reference engines for the differential harness (tools/differential.cpp) to check the optimized engines against.
+
+BaselineBook is the engine of the first version of book_analyzer (map <price : un_map <id : size> > per side and
+an <id : <side, price> > hash table, amounts in double), kept as it was apart from printing to a given stream,
+const comparators, and the walk reading the levels in place instead of copying them (unused parameters dropped).
+It reads A and R events only, and it differs from BookAnalyzer on purpose on some inputs, see tools/differential.cpp.
+
+ReferenceBook is the semantics of BookAnalyzer written in the most direct way, extensions included (modifies, level updates,
+time priority in the levels). It is slow on purpose and must stay simple:
+
+- a std::map <key : level> per side, each level a FIFO list of (order id, size), the order table maps ids to side and tick;
+- after every change of a side the target is evaluated again from scratch: if the side holds at least target shares
+  its levels are walked best-first and the amount is printed when it differs from the last one printed or the side was NA,
+  otherwise NA is printed once when the side goes from an amount to NA (prevNan);
+- nothing is cached: no best level, no fill boundary, no incremental totals beyond the size of each level.
+
+It covers the text feed events with a share target and the amount/NA lines, and applies them as BookAnalyzer does:
+adds of a known id and events on unknown ids are ignored without re-evaluation, a modify to the same price and
+a size not larger keeps the priority of the order, any other modify sends it to the back of its new level, a size of 0 or less
+cancels it, and a level update sets the whole size of a level fed by level updates only.
+Not covered: notional, approximate, consolidated, matching and top of book modes.
+*/
+
+class BaselineBook
+{
+    struct comparatorBuy {
+        bool operator()(const double& a, const double& b) const
+        {
+            return a > b;
+        }
+    };
+
+    struct comparatorSell {
+        bool operator()(const double& a, const double& b) const
+        {
+            return a < b;
+        }
+    };
+
+public:
+
+    BaselineBook(int target, std::ostream& out) : target_(target), totBuySize_(0), totSellSize_(0), prevExpenses_(0), prevNanExp_(true),
+        prevIncome_(0), prevNanIncome_(true), out_(out)
+    {
+        out_ << std::setprecision(2) << std::fixed;
+    }
+
+    int target_;
+    int totBuySize_;
+    int totSellSize_;
+    double prevExpenses_;
+    bool prevNanExp_;
+    double prevIncome_;
+    bool prevNanIncome_;
+
+    //keep items ordered by price, so that we can always get the next min/max available
+    //for each price we store a map with all the orders distinct by id, and corresponding size
+    //map <price : un_map <id : size> >
+    std::map<double, std::unordered_map<std::string, int>, comparatorBuy> buyMap_;
+    std::map<double, std::unordered_map<std::string, int>, comparatorSell> sellMap_;
+
+    //also keep all orders id in hash table, for each id we store the side (to pick the proper map) and the price, to find the element in the buy/sell maps
+    //map <id : <side, price> >
+    std::unordered_map<std::string, std::pair<Side, double>> hashTable_;
+
+    //the event loop of the first main(): A and R events, anything else is skipped
+    void apply(const FeedEvent& event)
+    {
+        if (event.type == 'A') //if new order process it
+        {
+            handleNewOrder(event.id, event.side, event.size, event.price, event.timestamp);
+        }
+        else if (event.type == 'R') //else reduce existing order
+        {
+            auto hashElem = hashTable_.find(event.id);
+
+            if (hashElem != hashTable_.end())
+            {
+                Side side = hashElem->second.first;
+                reduceOrder(event.id, side, event.size, event.timestamp);
+            }
+            else
+            {
+                //ignore, order id not found
+            }
+        }
+    }
+
+    long totalSize(const Side side) const
+    {
+        return side == Side::BUY ? totBuySize_ : totSellSize_;
+    }
+
+    void handleNewOrder(const std::string& id, const Side side, const int size, const double price, const long timestamp)
+    {
+        if(side == Side::BUY)
+            handleNewBuyOrder(size, price, id, timestamp);
+        else if (side == Side::SELL)
+            handleNewSellOrder(size, price, id, timestamp);
+
+        hashTable_.insert(std::make_pair(id, std::make_pair(side, price))); //add id to hashmap if it doesn't exist
+    }
+
+    void reduceOrder(const std::string& id, const Side side, const int size, const long timestamp)
+    {
+        auto hashElem = hashTable_.find(id);
+        auto price = hashElem->second.second;
+        bool removeFromMemory = false;
+
+        if (side == Side::BUY)
+            reduceBuyOrder(hashElem, price, size, timestamp, removeFromMemory);
+        else if (side == Side::SELL)
+            reduceSellOrder(hashElem, price, size, timestamp, removeFromMemory);
+        else
+        {
+            //ignore, unknown order type
+        }
+
+        if (removeFromMemory)
+            hashTable_.erase(id); //remove order id from hashtable since there is no remaining size on market
+    }
+
+private:
+
+    std::unordered_map<std::string, int> createNewInnerMap(const std::string id, const int size)
+    {
+        std::unordered_map<std::string, int> newMap;
+        newMap.emplace(std::make_pair(id, size));
+        return newMap;
+    }
+
+    void searchInnerMap(const std::unordered_map<std::string, int>& innerMap, double price, double& amount, int& currSize)
+    {
+        int localSize=0;
+        auto innerMapIter = innerMap.begin();
+        while(localSize<(target_-currSize) && innerMapIter!= innerMap.end())
+        {
+            localSize += innerMapIter->second;
+            ++innerMapIter;
+        }
+
+        if(localSize>(target_-currSize))
+            localSize = target_-currSize;
+
+        amount += localSize * price;
+        currSize += localSize;
+    }
+
+    void printNA(const long timestamp, bool& prevNan, Side side)
+    {
+        prevNan = true;
+        out_ << timestamp << (side == Side::BUY ? " S" : " B") << " NA" << '\n';
+    }
+
+    void print(const double& amount, double& prevAmount, bool& prevIsNan, const long timestamp, const Side side)
+    {
+        if (amount != prevAmount || prevIsNan == true)
+            out_ << timestamp << " " << (side == Side::BUY ? "S" :"B") << " " << amount << '\n';
+
+        prevAmount = amount;
+        prevIsNan = false;
+    }
+
+    void printBuy(long timestamp)
+    {
+        int currSize=0;
+        double income = 0;
+        auto it = buyMap_.begin();
+
+        while(currSize<target_ && it!=buyMap_.end())
+        {
+            searchInnerMap(it->second, it->first, income, currSize);
+            ++it;
+        }
+
+        print(income, prevExpenses_, prevNanExp_, timestamp, Side::BUY);
+    }
+
+    void printSell(long timestamp)
+    {
+        int currSize=0;
+        double expenses = 0;
+        auto it = sellMap_.begin();
+
+        while(currSize<target_ && it!=sellMap_.end())
+        {
+            searchInnerMap(it->second, it->first, expenses, currSize);
+            ++it;
+        }
+
+        print(expenses, prevIncome_, prevNanIncome_, timestamp, Side::SELL);
+    }
+
+    void handleNewBuyOrder(const int size, const double price, const std::string id, const long timestamp)
+    {
+        totBuySize_ += size;
+        auto buyIter = buyMap_.find(price);
+
+        if (buyIter != buyMap_.end())
+            buyIter->second.insert(std::make_pair(id, size));
+        else
+            buyMap_.emplace(std::make_pair(price, createNewInnerMap(id, size)));
+
+        if (target_<=totBuySize_)
+            printBuy(timestamp);
+    }
+
+    void handleNewSellOrder(const int size, const double price, const std::string id, long timestamp)
+    {
+        totSellSize_ += size;
+        auto sellIter = sellMap_.find(price);
+
+        if (sellIter != sellMap_.end())
+            sellIter->second.insert(std::make_pair(id, size));
+        else
+            sellMap_.emplace(std::make_pair(price, this->createNewInnerMap(id, size)));
+
+        if (target_<=totSellSize_)
+            printSell(timestamp);
+    }
+
+    bool searchId(std::unordered_map<std::string, int>& innerMap, const std::string& id, const int size, bool& removeFromMemory, int& totSize)
+    {
+        auto idIter = innerMap.find(id);
+        if (idIter != innerMap.end())
+        {
+            idIter->second -= size;
+
+            if (idIter->second <= 0)
+            {
+                innerMap.erase(id);
+
+                if (innerMap.empty())
+                    removeFromMemory = true;
+            }
+
+            totSize -= size;
+            return true;
+        }
+
+        return false;
+    }
+
+    void reduceBuyOrder(std::unordered_map<std::string, std::pair<Side, double>>::iterator& hashElem, const double price, const int size, const long timestamp, bool& removeFromMemory)
+    {
+        auto iter = buyMap_.find(price);
+
+        if(iter != buyMap_.end())
+        {
+            if (searchId(iter->second, hashElem->first, size, removeFromMemory, totBuySize_)) // look for the order to reduce by id
+            {
+                if (target_ <= totBuySize_)
+                    printBuy(timestamp);
+                else if (target_ > totBuySize_ && prevNanExp_ == false)
+                    printNA(timestamp, prevNanExp_, Side::BUY);
+            }
+        }
+
+        if (removeFromMemory)
+            buyMap_.erase(price);
+    }
+
+    void reduceSellOrder(std::unordered_map<std::string, std::pair<Side, double>>::iterator& hashElem, const double& price, const int size, const long timestamp, bool& removeFromMemory)
+    {
+        auto iter = sellMap_.find(price);
+
+        if(iter != sellMap_.end())
+        {
+            if (searchId(iter->second, hashElem->first, size, removeFromMemory, totSellSize_)) // look for the order to reduce by id
+            {
+                if (target_<= totSellSize_)
+                    printSell(timestamp);
+                else if (target_ > totSellSize_ && prevNanIncome_ == false)
+                    printNA(timestamp, prevNanIncome_, Side::SELL);
+            }
+        }
+
+        if (removeFromMemory)
+            sellMap_.erase(price);
+    }
+
+    std::ostream& out_;
+};
+
+class ReferenceBook
+{
+public:
+
+    ReferenceBook(const long target, std::ostream& out) : target_(target), out_(out), amount_{0, 0}, nan_{true, true}
+    {   }
+
+    void apply(const FeedEvent& event)
+    {
+        switch (event.type)
+        {
+        case 'A':
+            add(event.id, event.side, event.size, event.price, event.timestamp);
+            break;
+        case 'R':
+            reduce(event.id, event.size, event.timestamp);
+            break;
+        case 'M':
+            modify(event.id, event.size, event.price, event.timestamp);
+            break;
+        case 'L':
+            setLevel(event.side, event.size, event.price, event.timestamp);
+            break;
+        default:
+            break;
+        }
+    }
+
+    long totalSize(const Side side) const
+    {
+        long total = 0;
+        for (const auto& entry : levels_[side])
+            total += entry.second.size;
+        return total;
+    }
+
+    //(key, size) of the levels of side, best first
+    std::vector<std::pair<Tick, long>> levels(const Side side) const
+    {
+        std::vector<std::pair<Tick, long>> result;
+        for (const auto& entry : levels_[side])
+            result.emplace_back(entry.first, entry.second.size);
+        return result;
+    }
+
+    size_t orders() const { return orders_.size(); }
+
+    //shares ahead of the order in its level, -1 for an unknown id
+    long long queuePosition(const std::string& id) const
+    {
+        auto found = orders_.find(id);
+        if (found == orders_.end())
+            return -1;
+
+        const Side side = found->second.first;
+        long long ahead = 0;
+        for (const Order& order : levels_[side].at(tickToKey(found->second.second, side)).orders)
+        {
+            if (order.id == id)
+                break;
+            ahead += order.size;
+        }
+        return ahead;
+    }
+
+private:
+
+    struct Order
+    {
+        std::string id;
+        long size;
+    };
+
+    struct ReferenceLevel
+    {
+        long size = 0;
+        std::list<Order> orders;
+    };
+
+    void add(const std::string& id, const Side side, const int size, const double price, const long timestamp)
+    {
+        if ((side != Side::BUY && side != Side::SELL) || orders_.count(id) > 0)
+            return;
+
+        Tick tick = priceToTick(price);
+        orders_.emplace(id, std::make_pair(side, tick));
+        ReferenceLevel& level = levels_[side][tickToKey(tick, side)];
+        level.orders.push_back(Order{id, size});
+        level.size += size;
+        evaluate(side, timestamp);
+    }
+
+    void reduce(const std::string& id, const int size, const long timestamp)
+    {
+        auto found = orders_.find(id);
+        if (found == orders_.end())
+            return;
+
+        const Side side = found->second.first;
+        auto order = find(found->second.first, found->second.second, id);
+        takeOff(side, found->second.second, order, std::min<long>(size, order->size));
+        evaluate(side, timestamp);
+    }
+
+    void modify(const std::string& id, const int size, const double price, const long timestamp)
+    {
+        auto found = orders_.find(id);
+        if (found == orders_.end())
+            return;
+
+        const Side side = found->second.first;
+        const Tick tick = found->second.second;
+        const Tick newTick = priceToTick(price);
+        auto order = find(side, tick, id);
+        const long newSize = std::max(size, 0);
+
+        if (newTick == tick && newSize <= order->size)
+        {
+            takeOff(side, tick, order, order->size - newSize);
+        }
+        else
+        {
+            takeOff(side, tick, order, order->size);
+            if (newSize > 0)
+            {
+                orders_.emplace(id, std::make_pair(side, newTick));
+                ReferenceLevel& level = levels_[side][tickToKey(newTick, side)];
+                level.orders.push_back(Order{id, newSize});
+                level.size += newSize;
+            }
+        }
+
+        evaluate(side, timestamp);
+    }
+
+    void setLevel(const Side side, const long size, const double price, const long timestamp)
+    {
+        if (side != Side::BUY && side != Side::SELL)
+            return;
+
+        Tick key = tickToKey(priceToTick(price), side);
+        auto found = levels_[side].find(key);
+        if (found == levels_[side].end() && size <= 0)
+            return;
+
+        if (size <= 0)
+            levels_[side].erase(found);
+        else
+            levels_[side][key].size = size;
+
+        evaluate(side, timestamp);
+    }
+
+    std::list<Order>::iterator find(const Side side, const Tick tick, const std::string& id)
+    {
+        std::list<Order>& orders = levels_[side].at(tickToKey(tick, side)).orders;
+        return std::find_if(orders.begin(), orders.end(), [&id](const Order& order) { return order.id == id; });
+    }
+
+    //take shares off an order, removing it (and its level when nothing is left there) when it has none left
+    void takeOff(const Side side, const Tick tick, const std::list<Order>::iterator order, const long shares)
+    {
+        const Tick key = tickToKey(tick, side);
+        ReferenceLevel& level = levels_[side].at(key);
+        order->size -= shares;
+        level.size -= shares;
+        if (order->size > 0)
+            return;
+
+        orders_.erase(order->id);
+        level.orders.erase(order);
+        if (level.orders.empty() && level.size == 0)
+            levels_[side].erase(key);
+    }
+
+    //the BUY levels are sold into ('S' lines), the SELL levels are bought from ('B' lines)
+    void evaluate(const Side side, const long timestamp)
+    {
+        const char letter = side == Side::BUY ? 'S' : 'B';
+        if (totalSize(side) < target_)
+        {
+            if (!nan_[side])
+                out_ << timestamp << ' ' << letter << " NA\n";
+            nan_[side] = true;
+            return;
+        }
+
+        long filled = 0;
+        long long amount = 0; //in ticks
+        for (const auto& entry : levels_[side])
+        {
+            long shares = std::min(entry.second.size, target_ - filled);
+            amount += static_cast<long long>(shares) * (side == Side::BUY ? -entry.first : entry.first);
+            filled += shares;
+            if (filled == target_)
+                break;
+        }
+
+        if (amount != amount_[side] || nan_[side])
+        {
+            std::string cents = std::to_string(100 + amount * 100 / TICK_SCALE % 100);
+            out_ << timestamp << ' ' << letter << ' ' << amount * 100 / TICK_SCALE / 100 << '.' << cents.substr(1) << '\n';
+        }
+        amount_[side] = amount;
+        nan_[side] = false;
+    }
+
+    long target_;
+    std::ostream& out_;
+    std::map<Tick, ReferenceLevel> levels_[2]; //indexed by Side, keyed by tickToKey (best first)
+    std::unordered_map<std::string, std::pair<Side, Tick>> orders_; //id : side, tick
+    long long amount_[2];
+    bool nan_[2];
+};
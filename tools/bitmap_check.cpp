@@ -0,0 +1,138 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <set>
+
+#include "../occupancy_bitmap.h"
+
+/*
+Randomized check of OccupancyBitmap (occupancy_bitmap.h) against a std::set of the occupied slots:
+random sets and clears, and after every operation test/any and nextSet/nextSetCircular from the slot changed, from its
+neighbours, from the word and summary boundaries around it and from a random slot.
+
+The sizes cover one word, sizes that are not a multiple of 64, one and several summary words and the largest bitmap (64^3).
+Half of the operations stay in a small cluster so that words and summary words keep emptying and filling again,
+the other half spread over the whole bitmap so that the gaps between occupied slots are wide.
+The exit status is 1 on the first difference, which is reported with the size, the seed and the operation.
+
+Build: g++ -O2 -std=c++17 -o bitmap_check tools/bitmap_check.cpp
+Usage: bitmap_check [--seeds N] [--ops N]
+*/
+
+//first element >= pos, or NONE
+template <size_t Bits>
+size_t modelNext(const std::set<size_t>& model, const size_t pos)
+{
+    auto found = model.lower_bound(pos);
+    return found != model.end() ? *found : OccupancyBitmap<Bits>::NONE;
+}
+
+template <size_t Bits>
+bool checkAt(const OccupancyBitmap<Bits>& bitmap, const std::set<size_t>& model, const size_t pos, const char*& what)
+{
+    if (pos < Bits && bitmap.test(pos) != (model.count(pos) > 0))
+    {
+        what = "test";
+        return false;
+    }
+    if (bitmap.nextSet(pos) != modelNext<Bits>(model, pos))
+    {
+        what = "nextSet";
+        return false;
+    }
+
+    size_t circular = modelNext<Bits>(model, pos);
+    if (circular == OccupancyBitmap<Bits>::NONE && pos != 0)
+        circular = modelNext<Bits>(model, 0);
+    if (pos < Bits && bitmap.nextSetCircular(pos) != circular)
+    {
+        what = "nextSetCircular";
+        return false;
+    }
+    return true;
+}
+
+//one seed of random operations on a bitmap of Bits slots, false on the first difference
+template <size_t Bits>
+bool check(const unsigned seed, const long ops)
+{
+    std::mt19937 rng(seed);
+    OccupancyBitmap<Bits> bitmap;
+    std::set<size_t> model;
+    const size_t cluster = rng() % Bits;
+    const size_t width = 1 + Bits / 64;
+
+    for (long i = 0; i < ops; ++i)
+    {
+        size_t pos = rng() % 2 == 0 ? (cluster + rng() % width) % Bits : rng() % Bits;
+        if (rng() % 2 == 0)
+        {
+            bitmap.set(pos);
+            model.insert(pos);
+        }
+        else
+        {
+            bitmap.clear(pos);
+            model.erase(pos);
+        }
+
+        const char* what = "any";
+        const size_t word = pos & ~size_t(63);
+        const size_t summaryWord = pos & ~size_t(64 * 64 - 1);
+        const size_t probes[] = {pos, pos + 1, pos > 0 ? pos - 1 : 0, word, word + 64, summaryWord, summaryWord + 64 * 64, rng() % Bits, 0, Bits};
+        bool agree = bitmap.any() == !model.empty();
+        for (size_t probe : probes)
+        {
+            if (!agree)
+                break;
+            agree = checkAt(bitmap, model, probe, what);
+            pos = probe;
+        }
+
+        if (!agree)
+        {
+            std::cout << Bits << " slots, seed " << seed << " op " << i << ": " << what << " from " << pos << " disagrees" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <size_t Bits>
+bool checkSeeds(const unsigned seeds, const long ops)
+{
+    for (unsigned seed = 1; seed <= seeds; ++seed)
+    {
+        if (!check<Bits>(seed, ops))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned seeds = 10;
+    long ops = 20000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--seeds") == 0 && i + 1 < argc)
+            seeds = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--ops") == 0 && i + 1 < argc)
+            ops = std::atol(argv[++i]);
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (!checkSeeds<64>(seeds, ops) || !checkSeeds<100>(seeds, ops) || !checkSeeds<4096>(seeds, ops)
+        || !checkSeeds<5000>(seeds, ops) || !checkSeeds<65536>(seeds, ops) || !checkSeeds<262144>(seeds, ops))
+        return 1;
+
+    std::cout << "6 sizes, " << seeds << " seeds of " << ops << " operations each, the bitmap agrees with std::set" << std::endl;
+    return 0;
+}
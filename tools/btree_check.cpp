@@ -0,0 +1,166 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../book_levels.h"
+#include "../bplus_tree.h"
+
+/*
+Randomized check of the B+tree level container (bplus_tree.h) against MapLevels: random inserts, in-place size updates,
+erases and pops of the best level on both containers, and after every operation the same levels best-first,
+the same size and best key, and the same target and notional walks (the B+tree takes whole leaves through its
+lazily refreshed aggregates, MapLevels walks level by level).
+
+Small nodes (4 keys) make the tree split, grow, free leaves and shrink all the time; the key range of each seed
+keeps the tree between a handful and a few thousand levels. Keys are negative on half of the seeds, as on the buy side.
+The exit status is 1 on the first difference, which is reported with the seed and the operation.
+
+Build: g++ -O2 -std=c++17 -o btree_check tools/btree_check.cpp (add -fsanitize=address,undefined to check the node handling)
+Usage: btree_check [--seeds N] [--ops N]
+*/
+
+typedef BPlusTree<4, 4> SmallTree;
+
+//the levels best-first as text, for the comparison and the report
+template <class Levels>
+std::string listLevels(const Levels& levels)
+{
+    std::ostringstream out;
+    levels.forEach([&out](const Tick key, const Level& level)
+    {
+        out << key << ':' << level.size << ' ';
+        return true;
+    });
+    return out.str();
+}
+
+bool sameFill(const FillResult& a, const FillResult& b)
+{
+    return a.filled == b.filled && a.keyAmount == b.keyAmount && a.lastKey == b.lastKey && a.levels == b.levels;
+}
+
+bool sameFill(const NotionalFill& a, const NotionalFill& b)
+{
+    return a.filled == b.filled && a.keyAmount == b.keyAmount && a.lastKey == b.lastKey && a.complete == b.complete
+        && a.remaining == b.remaining && a.levels == b.levels;
+}
+
+//what differs between the tree and the map, empty when they agree
+std::string compare(SmallTree& tree, const MapLevels& map, std::mt19937& rng)
+{
+    if (tree.size() != map.size())
+        return "size " + std::to_string(tree.size()) + ", map " + std::to_string(map.size());
+    if (!map.empty() && tree.bestKey() != map.bestKey())
+        return "best key " + std::to_string(tree.bestKey()) + ", map " + std::to_string(map.bestKey());
+
+    std::string treeLevels = listLevels(tree);
+    std::string mapLevels = listLevels(map);
+    if (treeLevels != mapLevels)
+        return "levels\n" + treeLevels + "\nmap\n" + mapLevels;
+
+    const long target = 1 + static_cast<long>(rng() % 5000);
+    if (!sameFill(fillLevels(tree, target), fillLevels(map, target)))
+        return "target walk of " + std::to_string(target);
+
+    const long long notional = 1 + static_cast<long long>(rng() % 50000000);
+    if (!sameFill(fillNotional(tree, notional), fillNotional(map, notional)))
+        return "notional walk of " + std::to_string(notional);
+
+    return std::string();
+}
+
+//one seed of random operations, false on the first difference
+bool check(const unsigned seed, const long ops)
+{
+    std::mt19937 rng(seed);
+    const Tick range = Tick(8) << (seed % 10); //16 to 8192 keys
+    const Tick base = seed % 2 == 0 ? 1 : -range; //buy side keys are negated ticks
+    SmallTree tree;
+    MapLevels map;
+
+    for (long i = 0; i < ops; ++i)
+    {
+        const Tick key = base + static_cast<Tick>(rng() % static_cast<unsigned>(range));
+        const unsigned op = rng() % 8;
+        const char* name = "";
+
+        if (op < 4)
+        {
+            name = "insert";
+            const long size = 1 + static_cast<long>(rng() % 500);
+            tree.insert(key).size += size;
+            map.insert(key).size += size;
+        }
+        else if (op < 6)
+        {
+            name = "update";
+            Level* treeLevel = tree.find(key);
+            Level* mapLevel = map.find(key);
+            if ((treeLevel == nullptr) != (mapLevel == nullptr))
+            {
+                std::cout << "seed " << seed << " op " << i << ": find " << key << " disagrees" << std::endl;
+                return false;
+            }
+            if (treeLevel != nullptr)
+                treeLevel->size = mapLevel->size = 1 + static_cast<long>(rng() % 500);
+        }
+        else if (op == 6)
+        {
+            name = "erase";
+            tree.erase(key);
+            map.erase(key);
+        }
+        else if (!map.empty())
+        {
+            name = "pop best";
+            Level treeLevel = tree.popBest();
+            Level mapLevel = map.popBest();
+            if (treeLevel.size != mapLevel.size)
+            {
+                std::cout << "seed " << seed << " op " << i << ": popped size " << treeLevel.size << ", map " << mapLevel.size << std::endl;
+                return false;
+            }
+        }
+
+        std::string what = compare(tree, map, rng);
+        if (!what.empty())
+        {
+            std::cout << "seed " << seed << " op " << i << " (" << name << " " << key << "): " << what << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned seeds = 20;
+    long ops = 20000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--seeds") == 0 && i + 1 < argc)
+            seeds = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--ops") == 0 && i + 1 < argc)
+            ops = std::atol(argv[++i]);
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    for (unsigned seed = 1; seed <= seeds; ++seed)
+    {
+        if (!check(seed, ops))
+            return 1;
+    }
+
+    std::cout << seeds << " seeds of " << ops << " operations, the B+tree agrees with MapLevels" << std::endl;
+    return 0;
+}
@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../engine_factory.h"
+#include "../reference_book.h"
+#include "synthetic_feed.h"
+
+/*
+Differential harness: replays feeds through a reference engine (reference_book.h) and BookAnalyzer side by side.
+
+Against BaselineBook, the engine of the first version, the lines both printed and the total size of each side are compared
+after every event. The engine departs from the baseline on purpose where the baseline is wrong:
+- an add of an id already live is ignored, the baseline adds its size to the side total (not to the level) and re-evaluates;
+- a reduce larger than what is left of an order takes off what is left, the baseline takes the whole reduce off the side total;
+- an id can be used again once its order is gone, the baseline keeps the id (and its first price) until the whole level
+  of the order is gone, so reduces of the new order go to the old price and are lost;
+- amounts are summed exactly in ticks, the baseline sums doubles and can print the same amount again when two different
+  fills add up to the same amount with a different rounding error (such repeated lines are dropped before the comparison);
+- modifies and level updates are extensions, the baseline reads A and R events only.
+So only feeds of A and R events without those cases are compared with the baseline: the generated A/R feeds, and the
+feeds given on the command line that qualify.
+The baseline keeps prices as doubles, the engine rounds them to its ticks (see book_levels.h): every generated A/R feed
+is also compared with its prices moved off the cents (a few thousandths added) on an engine with a tick scale of 1000,
+and its sizes multiplied by 10 so that the amounts stay in whole cents and the baseline prints them exactly.
+
+Against ReferenceBook, a direct implementation of the engine's semantics with the extensions, after every event
+the lines both printed, the book state of each side (total size, and the key and size of every level) and, for the order
+the event refers to, the live order count and the shares ahead of it in its level are compared.
+
+Generated feeds come from SyntheticFeed with parameters varied per seed (few or many live orders, so that sides
+keep going in and out of NA, tight or wide books, modifies, aggressive prices), with edge events mixed in:
+adds of an id already live, reduces and modifies of unknown ids, reduces larger than the order, modifies to size 0.
+Text feeds given on the command line are replayed as they are.
+
+Every feed goes through ReferenceBook, the qualifying ones through BaselineBook as well.
+On the first mismatch the feed is cut after the failing event and minimized (delta debugging: chunks of events are
+dropped as long as the engines still disagree), the minimized feed is written to the --out file and its mismatch reported.
+The exit status is 1 when the engines disagree.
+
+Build: g++ -O2 -std=c++17 -o differential tools/differential.cpp
+Usage: differential [--book map|ladder|btree|flat|hybrid|all] [--index std|flat|direct] [--target N] [--band T] [--seeds N] [--events N]
+                    [--out file] [feed...]
+*/
+
+struct Config
+{
+    std::string book = "all";
+    std::string index = "std";
+    long target = 200;
+    long band = 0;
+    unsigned seeds = 20;
+    long events = 20000;
+    std::string out = "differential.min.in";
+    bool baseline = false; //the reference of the current check is BaselineBook instead of ReferenceBook
+    long tickScale = TICK_SCALE; //of the engine compared with the baseline
+};
+
+struct Mismatch
+{
+    size_t event = 0;
+    std::string what;
+};
+
+std::string describe(const FeedEvent& event)
+{
+    std::ostringstream line;
+    SyntheticFeed::write(line, event);
+    return line.str();
+}
+
+template <class Levels, class Index>
+bool compareSide(const BookAnalyzer<Levels, RuntimeParams, Index>& engine, const ReferenceBook& reference, const Side side, std::string& what)
+{
+    const char* name = side == Side::BUY ? "buy" : "sell";
+    long total = side == Side::BUY ? engine.totBuySize_ : engine.totSellSize_;
+    if (total != reference.totalSize(side))
+    {
+        what = std::string(name) + " total size " + std::to_string(total) + ", reference " + std::to_string(reference.totalSize(side));
+        return false;
+    }
+
+    //levels beyond the band are not on the levels, only the totals can be compared then
+    if (engine.bandTicks_ > 0)
+        return true;
+
+    std::vector<std::pair<Tick, long>> expected = reference.levels(side);
+    std::vector<std::pair<Tick, long>> actual;
+    (side == Side::BUY ? engine.buyMap_ : engine.sellMap_).forEach([&actual](const Tick key, const Level& level)
+    {
+        actual.emplace_back(key, level.size);
+        return true;
+    });
+
+    for (size_t i = 0; i < std::max(expected.size(), actual.size()); ++i)
+    {
+        if (i >= expected.size() || i >= actual.size() || expected[i] != actual[i])
+        {
+            std::ostringstream message;
+            message << name << " level " << i << ": ";
+            if (i < actual.size())
+                message << "key " << actual[i].first << " size " << actual[i].second;
+            else
+                message << "missing";
+            message << ", reference ";
+            if (i < expected.size())
+                message << "key " << expected[i].first << " size " << expected[i].second;
+            else
+                message << "missing";
+            what = message.str();
+            return false;
+        }
+    }
+    return true;
+}
+
+//lines of the baseline without the amounts it prints again unchanged (see above), last[side] is the amount last kept
+std::string dropRepeats(const std::string& lines, std::string last[2])
+{
+    std::istringstream in(lines);
+    std::string kept;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::string::size_type space = line.find(' ');
+        std::string& previous = last[line.compare(space + 1, 1, "S") == 0 ? Side::BUY : Side::SELL];
+        std::string amount = line.substr(space + 3);
+        if (amount != "NA" && amount == previous)
+            continue;
+        previous = amount;
+        kept += line + '\n';
+    }
+    return kept;
+}
+
+//whether the engine and the baseline must agree on events, see above
+bool baselineComparable(const std::vector<FeedEvent>& events)
+{
+    std::unordered_map<std::string, long> live; //id : size left, -1 once gone
+    for (const FeedEvent& event : events)
+    {
+        if (event.type == 'A')
+        {
+            if (!live.emplace(event.id, event.size).second)
+                return false; //an add of an id already seen
+        }
+        else if (event.type == 'R')
+        {
+            auto order = live.find(event.id);
+            if (order == live.end() || order->second < 0)
+                continue; //unknown ids are ignored by both
+            if (event.size > order->second)
+                return false;
+            order->second -= event.size;
+            if (order->second == 0)
+                order->second = -1;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//replay events through the engine and the baseline, false and the first mismatch when they disagree
+template <class E>
+bool replayBaseline(const std::vector<FeedEvent>& events, const Config& config, Mismatch& mismatch)
+{
+    std::ostringstream engineLines;
+    std::unique_ptr<OutputWriter> writer(new OutputWriter(engineLines));
+    BookAnalyzer<typename E::Levels, RuntimeParams, typename E::Index> engine(RuntimeParams(static_cast<int>(config.target), config.tickScale),
+                                                                               *writer);
+    engine.bandTicks_ = config.band;
+
+    std::ostringstream baselineLines;
+    BaselineBook baseline(static_cast<int>(config.target), baselineLines);
+    std::string last[2];
+
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        applyFeedEvent(engine, events[i]);
+        writer->flush();
+        baseline.apply(events[i]);
+
+        mismatch.event = i;
+        std::string expected = dropRepeats(baselineLines.str(), last);
+        if (engineLines.str() != expected)
+        {
+            mismatch.what = "printed\n" + engineLines.str() + "baseline printed\n" + expected;
+            return false;
+        }
+        engineLines.str("");
+        baselineLines.str("");
+
+        for (const Side side : {Side::BUY, Side::SELL})
+        {
+            long total = side == Side::BUY ? engine.totBuySize_ : engine.totSellSize_;
+            if (total != baseline.totalSize(side))
+            {
+                mismatch.what = std::string(side == Side::BUY ? "buy" : "sell") + " total size " + std::to_string(total) + ", baseline "
+                    + std::to_string(baseline.totalSize(side));
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//replay events through both engines, false and the first mismatch when they disagree
+template <class E>
+bool replay(const std::vector<FeedEvent>& events, const Config& config, Mismatch& mismatch)
+{
+    if (config.baseline)
+        return replayBaseline<E>(events, config, mismatch);
+
+    std::ostringstream engineLines;
+    std::unique_ptr<OutputWriter> writer(new OutputWriter(engineLines));
+    BookAnalyzer<typename E::Levels, RuntimeParams, typename E::Index> engine(RuntimeParams(static_cast<int>(config.target)), *writer);
+    engine.bandTicks_ = config.band;
+
+    std::ostringstream referenceLines;
+    ReferenceBook reference(config.target, referenceLines);
+
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        applyFeedEvent(engine, events[i]);
+        writer->flush();
+        reference.apply(events[i]);
+
+        mismatch.event = i;
+        if (engineLines.str() != referenceLines.str())
+        {
+            mismatch.what = "printed\n" + engineLines.str() + "reference printed\n" + referenceLines.str();
+            return false;
+        }
+        engineLines.str("");
+        referenceLines.str("");
+
+        if (!compareSide(engine, reference, Side::BUY, mismatch.what) || !compareSide(engine, reference, Side::SELL, mismatch.what))
+            return false;
+
+        if (engine.hashTable_.size() != reference.orders())
+        {
+            mismatch.what = "live orders " + std::to_string(engine.hashTable_.size()) + ", reference " + std::to_string(reference.orders());
+            return false;
+        }
+
+        const std::string& id = events[i].id;
+        if (!id.empty() && engine.queuePosition(id) != reference.queuePosition(id))
+        {
+            mismatch.what = "shares ahead of " + id + " " + std::to_string(engine.queuePosition(id)) + ", reference "
+                + std::to_string(reference.queuePosition(id));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//delta debugging: drop chunks of events while the engines still disagree, down to single events
+template <class E>
+std::vector<FeedEvent> minimize(std::vector<FeedEvent> events, const Config& config)
+{
+    Mismatch mismatch;
+    size_t chunks = 2;
+    while (events.size() >= 2)
+    {
+        size_t chunk = (events.size() + chunks - 1) / chunks;
+        bool reduced = false;
+        for (size_t start = 0; start < events.size() && !reduced; start += chunk)
+        {
+            std::vector<FeedEvent> complement(events.begin(), events.begin() + start);
+            complement.insert(complement.end(), events.begin() + std::min(start + chunk, events.size()), events.end());
+            if (!replay<E>(complement, config, mismatch))
+            {
+                events.assign(complement.begin(), complement.begin() + mismatch.event + 1);
+                chunks = std::max<size_t>(chunks - 1, 2);
+                reduced = true;
+            }
+        }
+
+        if (!reduced)
+        {
+            if (chunks >= events.size())
+                break;
+            chunks = std::min(events.size(), 2 * chunks);
+        }
+    }
+    return events;
+}
+
+//check one feed, on a mismatch minimize it and write it to config.out; false on a mismatch
+template <class E>
+bool check(const std::vector<FeedEvent>& events, const Config& config, const std::string& feed, const char* book)
+{
+    Mismatch mismatch;
+    if (replay<E>(events, config, mismatch))
+        return true;
+
+    const char* reference = config.baseline ? "baseline" : "reference";
+    std::cout << book << " book disagrees with the " << reference << " on " << feed << " at event " << mismatch.event << ": "
+              << describe(events[mismatch.event]) << mismatch.what << std::endl;
+
+    std::vector<FeedEvent> minimized(events.begin(), events.begin() + mismatch.event + 1);
+    minimized = minimize<E>(minimized, config);
+    replay<E>(minimized, config, mismatch);
+
+    std::ofstream out(config.out);
+    for (const FeedEvent& event : minimized)
+        SyntheticFeed::write(out, event);
+    std::cout << "minimized to " << minimized.size() << " events in " << config.out << ", last event " << describe(minimized.back())
+              << mismatch.what << std::endl;
+    return false;
+}
+
+//check one feed on the books of config, against the reference config.baseline names
+bool checkBooks(const std::vector<FeedEvent>& events, const Config& config, const std::string& feed)
+{
+    const char* books[] = {"map", "ladder", "btree", "flat", "hybrid"};
+    for (const char* book : books)
+    {
+        if (config.book != "all" && config.book != book)
+            continue;
+        bool agree = true;
+        selectEngine(book, config.index, [&](auto engine) { agree = check<decltype(engine)>(events, config, feed, book); });
+        if (!agree)
+            return false;
+    }
+    return true;
+}
+
+//synthetic feed of the seed with edge events mixed in, or an A/R feed without them to compare with the baseline
+std::vector<FeedEvent> generate(const unsigned seed, const long count, const bool baseline)
+{
+    const size_t maxOrders[] = {8, 40, 300};
+    const double dispersion[] = {1, 4, 32};
+
+    FeedParams params;
+    params.events = count;
+    params.seed = seed;
+    params.maxOrders = maxOrders[seed % 3];
+    params.dispersion = dispersion[seed / 3 % 3];
+    params.modifyRatio = seed % 2 == 0 && !baseline ? 0.2 : 0;
+    params.aggressiveRatio = seed % 5 == 0 ? 0.1 : 0;
+    params.volatility = 0.2;
+
+    SyntheticFeed feed(params);
+    std::mt19937 rng(seed);
+    std::vector<FeedEvent> events;
+    std::vector<std::string> ids;
+
+    FeedEvent event;
+    while (feed.next(event))
+    {
+        events.push_back(event);
+        if (event.type == 'A')
+            ids.push_back(event.id);
+        if (baseline)
+            continue;
+
+        FeedEvent edge = event;
+        switch (rng() % 64)
+        {
+        case 0: //add of an id already seen, ignored while it is live
+            edge.type = 'A';
+            edge.id = ids[rng() % ids.size()];
+            break;
+        case 1: //unknown id
+            edge.type = rng() % 2 == 0 ? 'R' : 'M';
+            edge.id = "unknown";
+            break;
+        case 2: //reduce by more than what is left
+            edge.type = 'R';
+            edge.id = ids[rng() % ids.size()];
+            edge.size = 100000;
+            break;
+        case 3: //modify to nothing, a cancel
+            edge.type = 'M';
+            edge.id = ids[rng() % ids.size()];
+            edge.size = 0;
+            break;
+        default:
+            continue;
+        }
+        events.push_back(edge);
+    }
+
+    return events;
+}
+
+//the A/R feed with every add moved 1 to 9 thousandths off its cent price, and every size multiplied by 10 (see above)
+std::vector<FeedEvent> offTick(std::vector<FeedEvent> events, const unsigned seed)
+{
+    std::mt19937 rng(seed);
+    for (FeedEvent& event : events)
+    {
+        if (event.type == 'A')
+            event.price += (1 + rng() % 9) / 1000.0;
+        event.size *= 10;
+    }
+    return events;
+}
+
+int main(int argc, char** argv)
+{
+    Config config;
+    std::vector<std::string> feeds;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--book") == 0 && i + 1 < argc)
+            config.book = argv[++i];
+        else if (std::strcmp(argv[i], "--index") == 0 && i + 1 < argc)
+            config.index = argv[++i];
+        else if (std::strcmp(argv[i], "--target") == 0 && i + 1 < argc)
+            config.target = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--band") == 0 && i + 1 < argc)
+            config.band = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--seeds") == 0 && i + 1 < argc)
+            config.seeds = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--events") == 0 && i + 1 < argc)
+            config.events = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            config.out = argv[++i];
+        else if (argv[i][0] != '-')
+            feeds.push_back(argv[i]);
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    Config baseline = config;
+    baseline.baseline = true;
+    Config fineTicks = baseline;
+    fineTicks.tickScale = 1000;
+
+    if (!selectEngine("map", config.index, [](auto) {}))
+    {
+        std::cerr << "unknown index " << config.index << std::endl;
+        return 1;
+    }
+
+    for (const std::string& file : feeds)
+    {
+        std::ifstream infile(file);
+        if (!infile)
+        {
+            std::cerr << "cannot open " << file << std::endl;
+            return 1;
+        }
+
+        std::vector<FeedEvent> events;
+        std::string line;
+        FeedEvent event;
+        while (std::getline(infile, line) && parseFeedEvent(line, event))
+            events.push_back(event);
+
+        if (!checkBooks(events, config, file))
+            return 1;
+        const bool comparable = baselineComparable(events);
+        if (comparable && !checkBooks(events, baseline, file))
+            return 1;
+        std::cout << file << ": " << events.size() << " events, engines agree"
+                  << (comparable ? ", with the baseline too" : ", not comparable with the baseline") << std::endl;
+    }
+
+    for (unsigned seed = 1; seed <= config.seeds; ++seed)
+    {
+        std::vector<FeedEvent> events = generate(seed, config.events, false);
+        if (!checkBooks(events, config, "seed " + std::to_string(seed)))
+            return 1;
+        events = generate(seed, config.events, true);
+        if (!checkBooks(events, baseline, "A/R seed " + std::to_string(seed)))
+            return 1;
+        if (!checkBooks(offTick(events, seed), fineTicks, "off-tick A/R seed " + std::to_string(seed)))
+            return 1;
+    }
+    if (config.seeds > 0)
+        std::cout << config.seeds << " generated feeds of " << config.events << " events, engines agree, "
+                  << config.seeds << " generated A/R feeds agree with the baseline, on cent and off-tick prices" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../book_analyzer.h"
+#include "../feed_event.h"
+#include "../itch_decoder.h"
+#include "itch_writer.h"
+
+/*
+Feed check: small feeds replayed through BookAnalyzer in process, each with the output it must print.
+Every case is a scenario where the engine once printed something else, kept so that it stays fixed:
+- consolidated split: the amount stays the same while a venue takes over the shares of another, the split changes
+  and the line must be printed again;
+- ITCH sub-penny prices: Price(4) fields are kept with their 4 decimals, not rounded to cents.
+The exit status is 1 when a case prints something else, the expected and the printed output are reported.
+
+Build: g++ -O2 -std=c++17 -o feed_check tools/feed_check.cpp
+Usage: feed_check
+*/
+
+struct Case
+{
+    const char* name;
+    std::function<void(OutputWriter&)> replay;
+    const char* expected;
+};
+
+//apply a text feed (one event per line) to the engine, with venue qualified ids in a consolidated book
+template <class Analyzer>
+void replayText(Analyzer& bookAnalyzer, const std::string& feed)
+{
+    std::istringstream in(feed);
+    std::string line;
+    FeedEvent event;
+    while (std::getline(in, line) && parseFeedEvent(line, event))
+    {
+        if (bookAnalyzer.consolidated_)
+            qualifyVenueId(event);
+        applyFeedEvent(bookAnalyzer, event);
+    }
+}
+
+std::vector<Case> cases()
+{
+    std::vector<Case> all;
+
+    all.push_back({"consolidated split", [](OutputWriter& out)
+    {
+        BookAnalyzer<> bookAnalyzer(RuntimeParams(200), out);
+        bookAnalyzer.consolidated_ = true;
+        replayText(bookAnalyzer,
+            "1 A a S 10.00 100 0\n"
+            "2 A b S 10.00 100 1\n"
+            "3 A c S 10.00 100 0\n"
+            "4 R b 100 1\n");
+    },
+        "2 B 2000.00 v0 100 1000.00 v1 100 1000.00\n"
+        "3 B 2000.00 v0 133 1330.00 v1 67 670.00\n"
+        "4 B 2000.00 v0 200 2000.00\n"});
+
+    all.push_back({"itch sub-penny prices", [](OutputWriter& out)
+    {
+        std::vector<uint8_t> capture;
+        ItchWriter itch(capture);
+        itch.addOrder(1000, 1, Side::SELL, 100, 100049); //10.0049
+        itch.addOrder(2000, 2, Side::SELL, 100, 100149); //10.0149
+        itch.orderExecuted(3000, 1, 50, 1);
+
+        BookAnalyzer<> bookAnalyzer(RuntimeParams(200, ITCH_TICK_SCALE), out);
+        ItchDecoder<BookAnalyzer<>> decoder(bookAnalyzer);
+        decoder.decodeStream(capture.data(), capture.size());
+    },
+        "2000 B 2001.98\n"
+        "3000 B NA\n"});
+
+    return all;
+}
+
+int main()
+{
+    std::vector<Case> all = cases();
+    for (const Case& check : all)
+    {
+        std::ostringstream printed;
+        {
+            OutputWriter out(printed);
+            check.replay(out);
+        }
+
+        if (printed.str() != check.expected)
+        {
+            std::cout << check.name << ": expected\n" << check.expected << "printed\n" << printed.str();
+            return 1;
+        }
+    }
+
+    std::cout << all.size() << " feeds print the expected output" << std::endl;
+    return 0;
+}
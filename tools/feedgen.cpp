@@ -0,0 +1,55 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "synthetic_feed.h"
+
+/*
+Writes a synthetic A/R/M feed to stdout, see synthetic_feed.h.
+
+Build: g++ -O2 -std=c++17 -o feedgen tools/feedgen.cpp
+Usage: feedgen [--events N] [--price P] [--drift T] [--volatility T] [--dispersion T] [--add-ratio R] [--max-orders N] [--aggressive R] [--modify R] [--seed S]
+*/
+
+int main(int argc, char** argv)
+{
+    FeedParams params;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--events") == 0)
+            params.events = std::atol(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--price") == 0)
+            params.startPrice = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--drift") == 0)
+            params.drift = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--volatility") == 0)
+            params.volatility = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--dispersion") == 0)
+            params.dispersion = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--add-ratio") == 0)
+            params.addRatio = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--max-orders") == 0)
+            params.maxOrders = static_cast<size_t>(std::atol(argv[i + 1]));
+        else if (std::strcmp(argv[i], "--aggressive") == 0)
+            params.aggressiveRatio = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--modify") == 0)
+            params.modifyRatio = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--seed") == 0)
+            params.seed = static_cast<unsigned>(std::atol(argv[i + 1]));
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::ios::sync_with_stdio(false);
+
+    SyntheticFeed feed(params);
+    FeedEvent event;
+    while (feed.next(event))
+        SyntheticFeed::write(std::cout, event);
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "synthetic_feed.h"
+
+/*
+Writes ITCH 5.0 messages (the ones decoded by itch_decoder.h), each preceded by its 2 byte big-endian length,
+used by the itchgen tool and by the benchmarks.
+
+ItchWriter encodes single messages. ItchEncoder turns A/R/M feed events into the equivalent messages:
+- A becomes an add (one in four with MPID attribution, F);
+- R becomes a delete when it removes the whole order, otherwise an execution or a cancel (alternating);
+- M becomes a cancel when it only downsizes the order, otherwise a replace with a new reference number.
+Timestamps are multiplied by timestampScale (feed milliseconds to ITCH nanoseconds by default).
+*/
+
+class ItchWriter
+{
+public:
+
+    explicit ItchWriter(std::vector<uint8_t>& out, const std::string& symbol = "SYNTH") : out_(out)
+    {
+        symbol_ = symbol;
+        symbol_.resize(8, ' ');
+    }
+
+    void systemEvent(const uint64_t timestamp, const char code)
+    {
+        begin('S', 12, timestamp);
+        put8(static_cast<uint8_t>(code));
+    }
+
+    void addOrder(const uint64_t timestamp, const uint64_t reference, const Side side, const uint32_t shares, const uint32_t price,
+                  const bool attribution = false)
+    {
+        begin(attribution ? 'F' : 'A', attribution ? 40 : 36, timestamp);
+        put64(reference);
+        put8(side == Side::BUY ? 'B' : 'S');
+        put32(shares);
+        for (char c : symbol_)
+            put8(static_cast<uint8_t>(c));
+        put32(price);
+        if (attribution)
+            put32(0x4d504944); //"MPID"
+    }
+
+    void orderExecuted(const uint64_t timestamp, const uint64_t reference, const uint32_t shares, const uint64_t match)
+    {
+        begin('E', 31, timestamp);
+        put64(reference);
+        put32(shares);
+        put64(match);
+    }
+
+    void orderCancel(const uint64_t timestamp, const uint64_t reference, const uint32_t shares)
+    {
+        begin('X', 23, timestamp);
+        put64(reference);
+        put32(shares);
+    }
+
+    void orderDelete(const uint64_t timestamp, const uint64_t reference)
+    {
+        begin('D', 19, timestamp);
+        put64(reference);
+    }
+
+    void orderReplace(const uint64_t timestamp, const uint64_t reference, const uint64_t newReference, const uint32_t shares,
+                      const uint32_t price)
+    {
+        begin('U', 35, timestamp);
+        put64(reference);
+        put64(newReference);
+        put32(shares);
+        put32(price);
+    }
+
+private:
+
+    void begin(const char type, const uint16_t length, const uint64_t timestamp)
+    {
+        put8(static_cast<uint8_t>(length >> 8));
+        put8(static_cast<uint8_t>(length));
+        put8(static_cast<uint8_t>(type));
+        put32(0); //stock locate and tracking number
+        for (int shift = 40; shift >= 0; shift -= 8)
+            put8(static_cast<uint8_t>(timestamp >> shift));
+    }
+
+    void put8(const uint8_t value)
+    {
+        out_.push_back(value);
+    }
+
+    void put32(const uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            put8(static_cast<uint8_t>(value >> shift));
+    }
+
+    void put64(const uint64_t value)
+    {
+        for (int shift = 56; shift >= 0; shift -= 8)
+            put8(static_cast<uint8_t>(value >> shift));
+    }
+
+    std::vector<uint8_t>& out_;
+    std::string symbol_;
+};
+
+class ItchEncoder
+{
+public:
+
+    explicit ItchEncoder(std::vector<uint8_t>& out, const uint64_t timestampScale = 1000000) :
+        writer_(out), timestampScale_(timestampScale), nextReference_(1), matches_(0), events_(0)
+    {   }
+
+    ItchWriter& writer() { return writer_; }
+
+    void encode(const FeedEvent& event)
+    {
+        uint64_t timestamp = static_cast<uint64_t>(event.timestamp) * timestampScale_;
+        ++events_;
+
+        if (event.type == 'A')
+        {
+            LiveOrder order{nextReference_++, event.size, price(event.price)};
+            if (!orders_.emplace(event.id, order).second)
+                return;
+            writer_.addOrder(timestamp, order.reference, event.side, static_cast<uint32_t>(event.size), order.price,
+                             order.reference % 4 == 0);
+            return;
+        }
+
+        auto found = orders_.find(event.id);
+        if (found == orders_.end())
+            return;
+
+        LiveOrder& order = found->second;
+        if (event.type == 'R')
+        {
+            if (event.size >= order.size)
+            {
+                writer_.orderDelete(timestamp, order.reference);
+                orders_.erase(found);
+            }
+            else
+            {
+                if (events_ & 1)
+                    writer_.orderExecuted(timestamp, order.reference, static_cast<uint32_t>(event.size), ++matches_);
+                else
+                    writer_.orderCancel(timestamp, order.reference, static_cast<uint32_t>(event.size));
+                order.size -= event.size;
+            }
+        }
+        else if (event.type == 'M')
+        {
+            uint32_t newPrice = price(event.price);
+            if (newPrice == order.price && event.size < order.size)
+            {
+                writer_.orderCancel(timestamp, order.reference, static_cast<uint32_t>(order.size - event.size));
+            }
+            else
+            {
+                uint64_t reference = nextReference_++;
+                writer_.orderReplace(timestamp, order.reference, reference, static_cast<uint32_t>(event.size), newPrice);
+                order.reference = reference;
+                order.price = newPrice;
+            }
+            order.size = event.size;
+        }
+    }
+
+private:
+
+    struct LiveOrder
+    {
+        uint64_t reference;
+        int size;
+        uint32_t price;
+    };
+
+    static uint32_t price(const double price)
+    {
+        return static_cast<uint32_t>(std::lround(price * 10000));
+    }
+
+    ItchWriter writer_;
+    uint64_t timestampScale_;
+    uint64_t nextReference_;
+    uint64_t matches_;
+    long events_;
+    std::unordered_map<std::string, LiveOrder> orders_;
+};
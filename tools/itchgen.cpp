@@ -0,0 +1,85 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "itch_writer.h"
+
+/*
+Writes an ITCH 5.0 capture (length prefixed messages, see itch_writer.h) to stdout,
+either from a synthetic feed (see synthetic_feed.h) or converting an A/R/M text feed.
+
+Build: g++ -O2 -std=c++17 -o itchgen tools/itchgen.cpp
+Usage: itchgen [--events N] [--modify R] [--seed S] [--from file] [--timestamp-scale K]
+  --from file           convert a text feed instead of generating one
+  --timestamp-scale K   ITCH timestamp = feed timestamp * K (default 1000000, milliseconds to nanoseconds)
+*/
+
+//the capture starts with a start of messages event, at the time of the first order event
+void encode(ItchEncoder& encoder, const FeedEvent& event, const uint64_t timestampScale)
+{
+    static bool started = false;
+    if (!started)
+    {
+        encoder.writer().systemEvent(static_cast<uint64_t>(event.timestamp) * timestampScale, 'O');
+        started = true;
+    }
+    encoder.encode(event);
+}
+
+int main(int argc, char** argv)
+{
+    FeedParams params;
+    const char* from = nullptr;
+    uint64_t timestampScale = 1000000;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--events") == 0)
+            params.events = std::atol(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--modify") == 0)
+            params.modifyRatio = std::atof(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--seed") == 0)
+            params.seed = static_cast<unsigned>(std::atol(argv[i + 1]));
+        else if (std::strcmp(argv[i], "--from") == 0)
+            from = argv[i + 1];
+        else if (std::strcmp(argv[i], "--timestamp-scale") == 0)
+            timestampScale = static_cast<uint64_t>(std::atoll(argv[i + 1]));
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<uint8_t> out;
+    ItchEncoder encoder(out, timestampScale);
+    FeedEvent event;
+    event.timestamp = -1;
+
+    if (from != nullptr)
+    {
+        std::ifstream infile(from);
+        if (!infile)
+        {
+            std::cerr << "cannot open " << from << std::endl;
+            return 1;
+        }
+
+        std::string line;
+        while (std::getline(infile, line) && parseFeedEvent(line, event))
+            encode(encoder, event, timestampScale);
+    }
+    else
+    {
+        SyntheticFeed feed(params);
+        while (feed.next(event))
+            encode(encoder, event, timestampScale);
+    }
+
+    if (event.timestamp >= 0)
+        encoder.writer().systemEvent(static_cast<uint64_t>(event.timestamp) * timestampScale, 'C'); //end of messages
+
+    std::cout.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    return 0;
+}
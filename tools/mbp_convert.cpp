@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "../book_levels.h"
+
+/*
+Converts an A/R/M order feed into the equivalent market-by-price feed (L events, see main.cpp), on stdout:
+every event that changes a level becomes the new total size of that level.
+
+A modify that moves an order to another price touches two levels and becomes two L events,
+so the analyzer output can show an intermediate state that the M event does not; A/R feeds convert exactly.
+
+Build: g++ -O2 -std=c++17 -o mbp_convert tools/mbp_convert.cpp
+Usage: mbp_convert [file]   (default book_analyzer.in)
+*/
+
+struct LiveOrder
+{
+    Side side;
+    Tick tick;
+    int size;
+};
+
+int main(int argc, char** argv)
+{
+    const char* file = argc > 1 ? argv[1] : "book_analyzer.in";
+    std::ifstream infile(file);
+    if (!infile)
+    {
+        std::cerr << "cannot open " << file << std::endl;
+        return 1;
+    }
+
+    std::unordered_map<std::string, LiveOrder> orders;
+    std::map<Tick, long> levels[2];
+
+    auto update = [&levels](const long timestamp, const Side side, const Tick tick, const long delta)
+    {
+        long& size = levels[side][tick];
+        size += delta;
+        std::printf("%ld L %c %.2f %ld\n", timestamp, side == Side::BUY ? 'B' : 'S', static_cast<double>(tick) / TICK_SCALE, size);
+        if (size == 0)
+            levels[side].erase(tick);
+    };
+
+    long timestamp;
+    char type;
+    std::string id;
+    double price;
+    int size;
+    std::string line;
+
+    while (std::getline(infile, line))
+    {
+        std::istringstream iss(line);
+        if (!(iss >> timestamp >> type))
+            break;
+
+        if (type == 'A')
+        {
+            char side;
+            iss >> id >> side >> price >> size;
+
+            LiveOrder order{side == 'B' ? Side::BUY : Side::SELL, priceToTick(price), size};
+            if (orders.emplace(id, order).second)
+                update(timestamp, order.side, order.tick, size);
+        }
+        else if (type == 'R' || type == 'M')
+        {
+            iss >> id;
+            if (type == 'M')
+                iss >> price;
+            iss >> size;
+
+            auto found = orders.find(id);
+            if (found == orders.end())
+                continue;
+
+            LiveOrder& order = found->second;
+            int remaining = type == 'R' ? order.size - std::min(size, order.size) : std::max(size, 0);
+            Tick tick = type == 'R' ? order.tick : priceToTick(price);
+
+            if (tick == order.tick)
+            {
+                update(timestamp, order.side, order.tick, remaining - order.size);
+            }
+            else
+            {
+                update(timestamp, order.side, order.tick, -order.size);
+                if (remaining > 0)
+                    update(timestamp, order.side, tick, remaining);
+            }
+
+            order.tick = tick;
+            order.size = remaining;
+            if (remaining == 0)
+                orders.erase(found);
+        }
+    }
+
+    return 0;
+}
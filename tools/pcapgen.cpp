@@ -0,0 +1,218 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../itch_decoder.h"
+
+/*
+Wraps an ITCH 5.0 capture (length prefixed messages, as written by itchgen) into MoldUDP64 packets sent to a multicast group
+and writes them as a pcap capture to stdout, to exercise pcap_reader.h.
+
+Each packet carries up to --batch messages, it is timestamped with the ITCH timestamp of its first message.
+With --noise every tenth packet is followed by a packet to another port and by a non IP frame, that the reader has to skip.
+
+Build: g++ -O2 -std=c++17 -o pcapgen tools/pcapgen.cpp
+Usage: pcapgen [--port P] [--batch N] [--format us|ns|ng] [--vlan ID] [--noise] file.itch
+*/
+
+struct PacketWriter
+{
+    std::string format = "us";
+    int vlan = -1;
+    std::vector<uint8_t> out;
+
+    void put16be(std::vector<uint8_t>& buffer, const uint32_t value)
+    {
+        buffer.push_back(static_cast<uint8_t>(value >> 8));
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    //capture headers in native (little-endian) byte order
+    void put32(const uint32_t value)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+            out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+
+    void put16(const uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    void fileHeader()
+    {
+        if (format == "ng")
+        {
+            //section header block
+            put32(0x0a0d0d0a);
+            put32(28);
+            put32(0x1a2b3c4d);
+            put16(1);
+            put16(0);
+            put32(0xffffffff);
+            put32(0xffffffff);
+            put32(28);
+            //interface description block: Ethernet, nanosecond timestamps (if_tsresol 9)
+            put32(1);
+            put32(32);
+            put16(1);
+            put16(0);
+            put32(65535);
+            put16(9);
+            put16(1);
+            put32(9);
+            put32(0); //end of options
+            put32(32);
+            return;
+        }
+
+        put32(format == "ns" ? 0xa1b23c4d : 0xa1b2c3d4);
+        put16(2);
+        put16(4);
+        put32(0);
+        put32(0);
+        put32(65535);
+        put32(1); //Ethernet
+    }
+
+    void frame(const uint64_t timestamp, const std::vector<uint8_t>& data)
+    {
+        if (format == "ng")
+        {
+            size_t padded = (data.size() + 3) & ~size_t(3);
+            put32(6);
+            put32(static_cast<uint32_t>(32 + padded));
+            put32(0);
+            put32(static_cast<uint32_t>(timestamp >> 32));
+            put32(static_cast<uint32_t>(timestamp));
+            put32(static_cast<uint32_t>(data.size()));
+            put32(static_cast<uint32_t>(data.size()));
+            out.insert(out.end(), data.begin(), data.end());
+            out.resize(out.size() + padded - data.size(), 0);
+            put32(static_cast<uint32_t>(32 + padded));
+            return;
+        }
+
+        put32(static_cast<uint32_t>(timestamp / 1000000000));
+        put32(static_cast<uint32_t>(format == "ns" ? timestamp % 1000000000 : timestamp % 1000000000 / 1000));
+        put32(static_cast<uint32_t>(data.size()));
+        put32(static_cast<uint32_t>(data.size()));
+        out.insert(out.end(), data.begin(), data.end());
+    }
+
+    //Ethernet (+ VLAN tag) / IPv4 / UDP frame to 233.54.12.111:port
+    void udp(const uint64_t timestamp, const uint16_t port, const std::vector<uint8_t>& payload)
+    {
+        std::vector<uint8_t> data = {0x01, 0x00, 0x5e, 0x36, 0x0c, 0x6f, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
+        if (vlan >= 0)
+        {
+            put16be(data, 0x8100);
+            put16be(data, static_cast<uint32_t>(vlan));
+        }
+        put16be(data, 0x0800);
+
+        size_t ipLength = 20 + 8 + payload.size();
+        const uint8_t ip[] = {0x45, 0, 0, 0, 0, 0, 0x40, 0, 32, 17, 0, 0, 10, 0, 0, 1, 233, 54, 12, 111};
+        size_t ipStart = data.size();
+        data.insert(data.end(), ip, ip + sizeof(ip));
+        data[ipStart + 2] = static_cast<uint8_t>(ipLength >> 8);
+        data[ipStart + 3] = static_cast<uint8_t>(ipLength);
+
+        put16be(data, 30000);
+        put16be(data, port);
+        put16be(data, static_cast<uint32_t>(8 + payload.size()));
+        put16be(data, 0);
+        data.insert(data.end(), payload.begin(), payload.end());
+
+        frame(timestamp, data);
+    }
+};
+
+int main(int argc, char** argv)
+{
+    PacketWriter writer;
+    uint16_t port = 26477;
+    size_t batch = 8;
+    bool noise = false;
+    const char* file = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            batch = static_cast<size_t>(std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+            writer.format = argv[++i];
+        else if (std::strcmp(argv[i], "--vlan") == 0 && i + 1 < argc)
+            writer.vlan = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--noise") == 0)
+            noise = true;
+        else if (argv[i][0] != '-')
+            file = argv[i];
+        else
+        {
+            std::cerr << "unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream infile(file != nullptr ? file : "", std::ios::binary);
+    if (!infile)
+    {
+        std::cerr << "cannot open " << (file != nullptr ? file : "(no file)") << std::endl;
+        return 1;
+    }
+    std::vector<uint8_t> itch((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+
+    writer.fileHeader();
+
+    uint64_t sequence = 1;
+    long packets = 0;
+    size_t pos = 0;
+    while (pos + 2 <= itch.size())
+    {
+        //MoldUDP64 header: session, sequence number, message count
+        std::vector<uint8_t> payload(20, 0);
+        std::memcpy(payload.data(), "SESSION001", 10);
+
+        uint64_t timestamp = 0;
+        size_t count = 0;
+        while (count < batch && pos + 2 <= itch.size() && payload.size() < 1400)
+        {
+            size_t length = ItchDecoder<int>::readBE16(itch.data() + pos);
+            if (pos + 2 + length > itch.size())
+                break;
+            if (count == 0 && length >= 11)
+                timestamp = ItchDecoder<int>::readBE48(itch.data() + pos + 2 + 5);
+
+            payload.insert(payload.end(), itch.begin() + static_cast<long>(pos), itch.begin() + static_cast<long>(pos + 2 + length));
+            pos += 2 + length;
+            ++count;
+        }
+        if (count == 0)
+            break;
+
+        for (int i = 0; i < 8; ++i)
+            payload[10 + i] = static_cast<uint8_t>(sequence >> (56 - 8 * i));
+        payload[18] = static_cast<uint8_t>(count >> 8);
+        payload[19] = static_cast<uint8_t>(count);
+        sequence += count;
+
+        writer.udp(timestamp, port, payload);
+
+        if (noise && ++packets % 10 == 0)
+        {
+            writer.udp(timestamp, static_cast<uint16_t>(port + 1), payload);
+            writer.frame(timestamp, std::vector<uint8_t>(60, 0x06)); //not IP
+        }
+    }
+
+    std::cout.write(reinterpret_cast<const char*>(writer.out.data()), static_cast<std::streamsize>(writer.out.size()));
+    return 0;
+}
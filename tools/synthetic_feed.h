@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../feed_event.h"
+
+/*
+Synthetic A/R/M feed generator, used by the feedgen tool and by the benchmarks.
+
+The mid price follows a random walk (drift + volatility, in ticks per event), new orders are placed around the mid
+at a distance drawn from an exponential distribution (dispersion, in ticks), and reduces hit live orders,
+either partially or fully. Reduces pick the worst of a few random live orders (crossed by the mid, or farthest from it),
+so that stale orders are cancelled and the book follows the mid as it drifts.
+Optionally some of those events are modifies instead, either downsizing the order or moving it back near the mid.
+*/
+
+struct FeedParams
+{
+    long events = 1000000;
+    double startPrice = 50.0;
+    double drift = 0.0;        //mean mid move per event, ticks
+    double volatility = 0.05;  //standard deviation of the mid move per event, ticks
+    double dispersion = 4.0;   //mean distance of new orders from the mid, ticks
+    double addRatio = 0.45;    //probability that an event is an add (when there are live orders)
+    size_t maxOrders = 1000;   //live orders cap, above it every event is a reduce
+    double aggressiveRatio = 0.0; //probability that an add is priced through the mid, on the opposite side's prices
+    double modifyRatio = 0.0;  //probability that a non-add event is a modify (downsize in place or reprice near the mid)
+    unsigned seed = 1;
+};
+
+class SyntheticFeed
+{
+public:
+
+    SyntheticFeed(const FeedParams& params) : params_(params), rng_(params.seed), emitted_(0), nextId_(0), timestamp_(28800000),
+        mid_(params.startPrice * TICK_SCALE)
+    {   }
+
+    bool next(FeedEvent& event)
+    {
+        if (emitted_ >= params_.events)
+            return false;
+
+        ++emitted_;
+        timestamp_ += 1 + static_cast<long>(rng_() % 50);
+        mid_ += params_.drift + params_.volatility * normal_(rng_);
+
+        event.timestamp = timestamp_;
+
+        if (orders_.empty() || (orders_.size() < params_.maxOrders && uniform_(rng_) < params_.addRatio))
+        {
+            event.type = 'A';
+            event.id = makeId(nextId_++);
+            event.side = rng_() & 1 ? Side::BUY : Side::SELL;
+            Tick distance = 1 + static_cast<Tick>(exponential_(rng_) * params_.dispersion);
+            if (params_.aggressiveRatio > 0 && uniform_(rng_) < params_.aggressiveRatio)
+                distance = -distance;
+            Tick tick = static_cast<Tick>(std::floor(mid_)) + (event.side == Side::BUY ? -distance : distance);
+            event.price = static_cast<double>(std::max<Tick>(tick, 1)) / TICK_SCALE;
+            event.size = 100 * (1 + static_cast<int>(rng_() % 5)) + (rng_() % 4 == 0 ? static_cast<int>(rng_() % 100) : 0);
+
+            orders_.push_back(LiveOrder{event.id, event.side, tick, event.size});
+            return true;
+        }
+
+        size_t index = rng_() % orders_.size();
+        for (int i = 0; i < 3; ++i)
+        {
+            size_t candidate = rng_() % orders_.size();
+            if (staleness(orders_[candidate]) > staleness(orders_[index]))
+                index = candidate;
+        }
+
+        LiveOrder& order = orders_[index];
+
+        if (params_.modifyRatio > 0 && uniform_(rng_) < params_.modifyRatio)
+        {
+            event.type = 'M';
+            event.id = order.id;
+            if (rng_() & 1 && order.size > 1)
+            {
+                event.size = 1 + static_cast<int>(rng_() % (order.size - 1));
+            }
+            else
+            {
+                Tick distance = 1 + static_cast<Tick>(exponential_(rng_) * params_.dispersion);
+                order.tick = std::max<Tick>(static_cast<Tick>(std::floor(mid_)) + (order.side == Side::BUY ? -distance : distance), 1);
+                event.size = 100 * (1 + static_cast<int>(rng_() % 5));
+            }
+            event.price = static_cast<double>(order.tick) / TICK_SCALE;
+            order.size = event.size;
+            return true;
+        }
+
+        event.type = 'R';
+        event.id = order.id;
+        event.size = rng_() % 3 == 0 && order.size > 1 ? 1 + static_cast<int>(rng_() % (order.size - 1)) : order.size;
+
+        order.size -= event.size;
+        if (order.size == 0)
+        {
+            order = orders_.back();
+            orders_.pop_back();
+        }
+
+        return true;
+    }
+
+    static void write(std::ostream& out, const FeedEvent& event)
+    {
+        char buffer[128];
+        const int decimals = priceDecimals(event.price);
+        if (event.type == 'A')
+            std::snprintf(buffer, sizeof(buffer), "%ld A %s %c %.*f %d\n", event.timestamp, event.id.c_str(),
+                          event.side == Side::BUY ? 'B' : 'S', decimals, event.price, event.size);
+        else if (event.type == 'M')
+            std::snprintf(buffer, sizeof(buffer), "%ld M %s %.*f %d\n", event.timestamp, event.id.c_str(), decimals, event.price, event.size);
+        else if (event.type == 'L')
+            std::snprintf(buffer, sizeof(buffer), "%ld L %c %.*f %d\n", event.timestamp, event.side == Side::BUY ? 'B' : 'S',
+                          decimals, event.price, event.size);
+        else
+            std::snprintf(buffer, sizeof(buffer), "%ld R %s %d\n", event.timestamp, event.id.c_str(), event.size);
+
+        out << buffer;
+    }
+
+    //2 decimals for prices in cents, up to 6 for finer ones (the off-tick feeds of tools/differential.cpp)
+    static int priceDecimals(const double price)
+    {
+        int decimals = 2;
+        double scaled = price * 100;
+        for (; decimals < 6 && std::fabs(scaled - std::round(scaled)) > 1e-6; ++decimals)
+            scaled *= 10;
+        return decimals;
+    }
+
+private:
+
+    struct LiveOrder
+    {
+        std::string id;
+        Side side;
+        Tick tick;
+        int size;
+    };
+
+    //distance from the mid on the passive side, orders crossed by the mid are the stalest
+    double staleness(const LiveOrder& order) const
+    {
+        double distance = order.side == Side::BUY ? mid_ - order.tick : order.tick - mid_;
+        return distance < 0 ? 1e18 : distance;
+    }
+
+    static std::string makeId(long n)
+    {
+        std::string id;
+        do
+        {
+            id += static_cast<char>('a' + n % 26);
+            n /= 26;
+        } while (n > 0);
+
+        return id;
+    }
+
+    FeedParams params_;
+    std::mt19937_64 rng_;
+    std::normal_distribution<double> normal_;
+    std::uniform_real_distribution<double> uniform_;
+    std::exponential_distribution<double> exponential_;
+    long emitted_;
+    long nextId_;
+    long timestamp_;
+    double mid_;
+    std::vector<LiveOrder> orders_;
+};
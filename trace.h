@@ -0,0 +1,228 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+Opt-in timeline of the engine phases, written as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+
+Built with -DBOOK_TRACE, TRACE_SCOPE(name) records a complete event (begin and duration) for the enclosing scope:
+parse chunks, batch application, target walks, output flushes. Without BOOK_TRACE the macros expand to nothing
+and no trace code is compiled in. Built with it, nothing is recorded until Tracer::start, a scope then costs
+a relaxed load and nothing else.
+
+Every thread appends to its own buffer, registered under the tracer lock the first time the thread records:
+after that an event is a plain store into memory only that thread writes, no lock and no atomic.
+A full buffer drops events (counted, see dropped). The buffers belong to the tracer and outlive their threads,
+write is called at the end of the run once the other recording threads are joined.
+
+TRACE_SAMPLED_SCOPE is for the scopes entered once per book change (the target walks): it records one call
+in sampleEvery per thread, so that a coarse sampling keeps the cost of tracing them negligible.
+*/
+
+struct TraceEvent
+{
+    const char* name; //a string literal
+    int64_t begin; //ns since Tracer::start
+    int64_t duration; //ns
+};
+
+struct TraceBuffer
+{
+    std::string thread;
+    std::vector<TraceEvent> events;
+    long dropped = 0;
+    long skip = 0; //sampled scopes left to skip before the next one recorded
+};
+
+class Tracer
+{
+public:
+
+    static const size_t DEFAULT_CAPACITY = 1 << 20; //events per thread
+
+    //never destroyed, scopes may still be left during static destruction (the output writer flushes at exit)
+    static Tracer& instance()
+    {
+        static Tracer* tracer = new Tracer();
+        return *tracer;
+    }
+
+    void start(const long sampleEvery = 1, const size_t capacity = DEFAULT_CAPACITY)
+    {
+        sampleEvery_ = sampleEvery > 0 ? sampleEvery : 1;
+        capacity_ = capacity;
+        origin_ = std::chrono::steady_clock::now();
+        enabled_.store(true, std::memory_order_release);
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin_).count();
+    }
+
+    void record(const char* name, const int64_t begin)
+    {
+        TraceBuffer& buffer = local();
+        if (buffer.events.size() < capacity_)
+            buffer.events.push_back(TraceEvent{name, begin, now() - begin});
+        else
+            ++buffer.dropped;
+    }
+
+    //true for one call in sampleEvery on the calling thread, false for all calls when not enabled
+    bool sample()
+    {
+        if (!enabled())
+            return false;
+
+        TraceBuffer& buffer = local();
+        if (buffer.skip > 0)
+        {
+            --buffer.skip;
+            return false;
+        }
+        buffer.skip = sampleEvery_ - 1;
+        return true;
+    }
+
+    //name of the calling thread in the timeline
+    void nameThread(const std::string& name)
+    {
+        if (enabled())
+            local().thread = name;
+    }
+
+    long dropped() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        long result = 0;
+        for (const std::unique_ptr<TraceBuffer>& buffer : buffers_)
+            result += buffer->dropped;
+        return result;
+    }
+
+    //write the events of all threads as Chrome trace JSON, the recording threads must be done
+    bool write(const std::string& file) const
+    {
+        std::ofstream out(file);
+        if (!out)
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        const char* separator = "\n";
+        for (size_t tid = 0; tid < buffers_.size(); ++tid)
+        {
+            const TraceBuffer& buffer = *buffers_[tid];
+            if (!buffer.thread.empty())
+            {
+                out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid + 1
+                    << ",\"args\":{\"name\":\"" << escape(buffer.thread) << "\"}}";
+                separator = ",\n";
+            }
+
+            for (const TraceEvent& event : buffer.events)
+            {
+                out << separator << "{\"name\":\"" << escape(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid + 1
+                    << ",\"ts\":" << micros(event.begin) << ",\"dur\":" << micros(event.duration) << "}";
+                separator = ",\n";
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+
+    Tracer() : enabled_(false), sampleEvery_(1), capacity_(DEFAULT_CAPACITY)
+    {   }
+
+    //the buffer of the calling thread, registered on its first event
+    TraceBuffer& local()
+    {
+        thread_local TraceBuffer* buffer = nullptr;
+        if (buffer == nullptr)
+        {
+            std::unique_ptr<TraceBuffer> created(new TraceBuffer());
+            created->events.reserve(capacity_);
+            buffer = created.get();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.push_back(std::move(created));
+        }
+        return *buffer;
+    }
+
+    //ns to µs with 3 decimals, the unit of the trace format
+    static std::string micros(const int64_t ns)
+    {
+        std::string fraction = std::to_string(1000 + ns % 1000);
+        return std::to_string(ns / 1000) + "." + fraction.substr(1);
+    }
+
+    static std::string escape(const std::string& text)
+    {
+        std::string result;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+
+    std::atomic<bool> enabled_;
+    long sampleEvery_;
+    size_t capacity_;
+    std::chrono::steady_clock::time_point origin_;
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+};
+
+//records the lifetime of the scope when record is true and the tracer is enabled
+class TraceScope
+{
+public:
+
+    explicit TraceScope(const char* name, const bool record = true)
+        : name_(record && Tracer::instance().enabled() ? name : nullptr), begin_(name_ != nullptr ? Tracer::instance().now() : 0)
+    {   }
+
+    ~TraceScope()
+    {
+        if (name_ != nullptr)
+            Tracer::instance().record(name_, begin_);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+
+    const char* name_;
+    int64_t begin_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef BOOK_TRACE
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_SAMPLED_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name, Tracer::instance().sample())
+#define TRACE_THREAD_NAME(name) Tracer::instance().nameThread(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SAMPLED_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif